@@ -26,21 +26,12 @@
 #include <commons.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <sysinfo.h>
 
 #if defined(__x86_64__)
    #include <cpuid.h>
 #endif
 
-struct cpuinfo {
-    uint64_t conf_cores;
-    uint64_t onln_cores;
-    char model_name[64];
-    char vendor_name[64];
-    uint32_t base_mhz;
-    uint32_t max_mhz;
-    uint32_t ref_mhz;
-};
-
 int main(int argc, char *argv[]) {
     bool only_name  = false;
     bool only_cores = false;
@@ -73,9 +64,7 @@ int main(int argc, char *argv[]) {
 
     // Fetch CPU information by using getcpuinfo.
     struct cpuinfo cpu;
-    int ret, errno;
-    SYSCALL1(SYSCALL_GETCPUINFO, &cpu);
-    if (ret == -1) {
+    if (sysinfo_cpuinfo(&cpu)) {
         perror("Could not get CPU information from the kernel");
         return 1;
     }
@@ -22,10 +22,92 @@
 #include <sys/syscall.h>
 #include <math.h>
 #include <commons.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <getopt.h>
+#include <klog.h>
+
+#define FOLLOW_INTERVAL_MS 1000
+
+// Substring matcher for --grep, with its skip table built once up front.
+struct matcher {
+    const char *pattern;
+    size_t len;
+    size_t skip[256];
+};
+
+static void build_matcher(struct matcher *m, const char *pattern) {
+    m->pattern = pattern;
+    m->len = strlen(pattern);
+    for (int i = 0; i < 256; i++) {
+        m->skip[i] = m->len;
+    }
+    for (size_t i = 0; i + 1 < m->len; i++) {
+        m->skip[(unsigned char)pattern[i]] = m->len - 1 - i;
+    }
+}
+
+static bool matches(const struct matcher *m, const char *str, size_t len) {
+    if (m->len == 0) {
+        return true;
+    }
+    for (size_t i = 0; i + m->len <= len; i += m->skip[(unsigned char)str[i + m->len - 1]]) {
+        if (!memcmp(str + i, m->pattern, m->len)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void print_json_string(const char *str, int len) {
+    putchar('"');
+    for (int i = 0; i < len; i++) {
+        unsigned char ch = str[i];
+        if (ch == '"' || ch == '\\') {
+            printf("\\%c", ch);
+        } else if (ch < 0x20) {
+            printf("\\u%04x", ch);
+        } else {
+            putchar(ch);
+        }
+    }
+    putchar('"');
+}
+
+static void print_record(const struct klog_record *rec, bool as_json) {
+    if (as_json) {
+        printf("{\"time\":%.6f,\"level\":\"%s\",\"subsystem\":", rec->seconds,
+               klog_level_names[rec->level]);
+        print_json_string(rec->subsystem, rec->subsystem_len);
+        printf(",\"message\":");
+        print_json_string(rec->message, rec->message_len);
+        printf("}\n");
+    } else {
+        printf("%.*s\n", rec->line_len, rec->line);
+    }
+}
 
 int main(int argc, char *argv[]) {
+    bool follow = false;
+    bool as_json = false;
+    bool wanted_levels[KLOG_LEVEL_COUNT] = {true, true, true, true};
+    bool do_grep = false;
+    struct matcher grep;
+    double since = 0;
+
+    static const struct option long_options[] = {
+        {"level", required_argument, NULL, 'l'},
+        {"grep",  required_argument, NULL, 'g'},
+        {"since", required_argument, NULL, 's'},
+        {"json",  no_argument,       NULL, 'j'},
+        {NULL,    0,                 NULL, 0}
+    };
+
     char c;
-    while ((c = getopt (argc, argv, "hv")) != -1) {
+    char *tok;
+    while ((c = getopt_long(argc, argv, "hvwl:g:s:j", long_options, NULL)) != -1) {
         switch (c) {
             case 'h':
                 puts("Usage: dmesg [options]");
@@ -33,28 +115,93 @@ int main(int argc, char *argv[]) {
                 puts("Options:");
                 puts("-h              Print this help message");
                 puts("-v              Display version information.");
+                puts("-w              Wait for new messages and print them");
+                puts("-l|--level <l>  Only print the comma-separated levels, out of");
+                puts("                crit, err, warn and info");
+                puts("-g|--grep <str> Only print messages containing the string");
+                puts("-s|--since <s>  Only print messages from s seconds after boot on");
+                puts("-j|--json       Print messages as JSON objects, one per line");
                 return 0;
             case 'v':
                puts("dmesg" VERSION_STR);
                return 0;
+            case 'w':
+               follow = true;
+               break;
+            case 'l':
+               for (int i = 0; i < KLOG_LEVEL_COUNT; i++) {
+                   wanted_levels[i] = false;
+               }
+               tok = strtok(optarg, ",");
+               while (tok != NULL) {
+                   int i = 0;
+                   while (i < KLOG_LEVEL_COUNT && strcmp(tok, klog_level_names[i])) {
+                       i++;
+                   }
+                   if (i == KLOG_LEVEL_COUNT) {
+                       fprintf(stderr, "dmesg: Unknown level '%s'\n", tok);
+                       return 1;
+                   }
+                   wanted_levels[i] = true;
+                   tok = strtok(NULL, ",");
+               }
+               break;
+            case 'g':
+               do_grep = true;
+               build_matcher(&grep, optarg);
+               break;
+            case 's':
+               if (sscanf(optarg, "%lf", &since) != 1) {
+                   fprintf(stderr, "dmesg: '%s' is not a valid time\n", optarg);
+                   return 1;
+               }
+               break;
+            case 'j':
+               as_json = true;
+               break;
             default:
                 fprintf(stderr, "dmesg: Unknown option '%c'\n", optopt);
                 return 1;
         }
     }
 
-    size_t length = 100 * 80;
+    size_t length = KLOG_INITIAL_LINES * KLOG_LINE_LEN;
     char *logs = malloc(length);
-    int ret, errno;
-    SYSCALL2(SYSCALL_DUMPLOGS, logs, length);
-    if (ret == -1) {
+    struct klog_record *records = NULL;
+    if (logs == NULL) {
         return 1;
     }
 
-    for (size_t i = 0; i < length; i += 80) {
-       if (logs[i] == '(') {
-           printf("%.80s\n", logs + i);
-       }
+    struct klog_cursor cursor = {0};
+    for (;;) {
+        logs = klog_fetch(logs, &length);
+        if (logs == NULL) {
+            return 1;
+        }
+
+        records = realloc(records, (length / KLOG_LINE_LEN) * sizeof(struct klog_record));
+        if (records == NULL) {
+            return 1;
+        }
+
+        size_t count = klog_parse_new(logs, length, &cursor, records);
+        for (size_t i = 0; i < count; i++) {
+            const struct klog_record *rec = &records[i];
+            if (wanted_levels[rec->level] && rec->seconds >= since &&
+                (!do_grep || matches(&grep, rec->line, rec->line_len))) {
+                print_record(rec, as_json);
+            }
+        }
+        if (!follow) {
+            break;
+        }
+
+        fflush(stdout);
+        struct timespec interval = {
+            .tv_sec  = FOLLOW_INTERVAL_MS / 1000,
+            .tv_nsec = (FOLLOW_INTERVAL_MS % 1000) * 1000000
+        };
+        nanosleep(&interval, NULL);
     }
    return 0;
 }
@@ -28,6 +28,12 @@
 #include <stdint.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <elfsym.h>
 
 struct registers {
     uint64_t rax;
@@ -53,22 +59,398 @@ struct registers {
     uint64_t ss;
 } __attribute__((packed));
 
+// A dump is the register state at the time of the fault, optionally followed
+// by a copy of the stack memory starting at the faulting RSP.
+#define MAX_FRAMES 64
+
+struct dump {
+    void *map;
+    size_t map_size;
+    struct registers regs;
+    const unsigned char *stack;
+    size_t stack_len;
+    int frame_count;
+    uint64_t frames[MAX_FRAMES];
+};
+
+// Returns 0 on success, -1 on errors with errno set, and DUMP_TOO_SHORT if
+// the file cannot even hold the registers.
+#define DUMP_TOO_SHORT -2
+
+static int load_dump(const char *path, struct dump *dump) {
+    int core_fd = open(path, O_RDONLY);
+    if (core_fd == -1) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(core_fd, &st)) {
+        close(core_fd);
+        return -1;
+    } else if ((size_t)st.st_size < sizeof(struct registers)) {
+        close(core_fd);
+        return DUMP_TOO_SHORT;
+    }
+
+    dump->map_size = st.st_size;
+    dump->map = mmap(NULL, dump->map_size, PROT_READ, MAP_PRIVATE, core_fd, 0);
+    close(core_fd);
+    if (dump->map == MAP_FAILED) {
+        return -1;
+    }
+
+    memcpy(&dump->regs, dump->map, sizeof(struct registers));
+    dump->stack = (const unsigned char *)dump->map + sizeof(struct registers);
+    dump->stack_len = dump->map_size - sizeof(struct registers);
+    return 0;
+}
+
+static void unload_dump(struct dump *dump) {
+    munmap(dump->map, dump->map_size);
+}
+
+static bool read_stack(struct dump *dump, uint64_t addr, uint64_t *value) {
+    if (addr < dump->regs.rsp || addr - dump->regs.rsp + sizeof(uint64_t) > dump->stack_len) {
+        return false;
+    }
+    memcpy(value, dump->stack + (addr - dump->regs.rsp), sizeof(uint64_t));
+    return true;
+}
+
+// Walk the chain of saved frame pointers, which only works as long as the
+// code was built with frame pointers and the frames are in the dumped stack.
+static void walk_frames(struct dump *dump) {
+    dump->frames[0] = dump->regs.rip;
+    dump->frame_count = 1;
+
+    uint64_t rbp = dump->regs.rbp;
+    while (dump->frame_count < MAX_FRAMES && rbp % sizeof(uint64_t) == 0) {
+        uint64_t saved_rbp, ret_addr;
+        if (!read_stack(dump, rbp, &saved_rbp) ||
+            !read_stack(dump, rbp + sizeof(uint64_t), &ret_addr) || ret_addr == 0) {
+            break;
+        }
+        dump->frames[dump->frame_count++] = ret_addr;
+
+        // Stacks grow down, so callers are always at higher addresses.
+        if (saved_rbp <= rbp) {
+            break;
+        }
+        rbp = saved_rbp;
+    }
+}
+
+static void print_address(struct elf_symbols *syms, uint64_t addr) {
+    const struct elf_symbol *sym = syms != NULL ? elfsym_lookup(syms, addr) : NULL;
+    if (sym != NULL) {
+        printf("%016" PRIx64 " %s+0x%" PRIx64 "\n", addr, sym->name, addr - sym->addr);
+    } else {
+        printf("%016" PRIx64 " ??\n", addr);
+    }
+}
+
+// Batch triage. Every dump in a directory is reduced to a fault signature,
+// made of the binary, the symbolized RIP, and the functions of the first
+// few callers, and dumps with the same signature are grouped together.
+#define SIGNATURE_FRAMES 3
+#define SIGNATURE_LEN 512
+
+struct triage_entry {
+    char *name;
+    uint64_t size;
+    int64_t mtime;
+    char *signature; // NULL until processed.
+};
+
+struct triage {
+    const char *dir;
+    const char *binary;
+    uint64_t binary_size;
+    int64_t binary_mtime;
+    struct elf_symbols *syms;
+    size_t count;
+    struct triage_entry *entries;
+    atomic_size_t next;
+};
+
+static void append_frame(char *buf, size_t len, struct elf_symbols *syms,
+                         uint64_t addr, bool with_offset) {
+    size_t used = strlen(buf);
+    const struct elf_symbol *sym = syms != NULL ? elfsym_lookup(syms, addr) : NULL;
+    if (sym != NULL && with_offset) {
+        snprintf(buf + used, len - used, "%s+0x%" PRIx64, sym->name, addr - sym->addr);
+    } else if (sym != NULL) {
+        snprintf(buf + used, len - used, "%s", sym->name);
+    } else {
+        snprintf(buf + used, len - used, "0x%" PRIx64, addr);
+    }
+}
+
+static char *dump_signature(struct dump *dump, const char *binary,
+                            struct elf_symbols *syms) {
+    char buf[SIGNATURE_LEN];
+    snprintf(buf, sizeof(buf), "%s:", binary);
+    append_frame(buf, sizeof(buf), syms, dump->frames[0], true);
+    for (int i = 1; i < dump->frame_count && i <= SIGNATURE_FRAMES; i++) {
+        strncat(buf, " < ", sizeof(buf) - strlen(buf) - 1);
+        append_frame(buf, sizeof(buf), syms, dump->frames[i], false);
+    }
+    return strdup(buf);
+}
+
+static void *triage_worker(void *arg) {
+    struct triage *triage = arg;
+    char path[1024];
+
+    // Entries are handed out with an atomic counter, no locking needed.
+    size_t idx;
+    while ((idx = atomic_fetch_add(&triage->next, 1)) < triage->count) {
+        struct triage_entry *entry = &triage->entries[idx];
+        if (entry->signature != NULL) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", triage->dir, entry->name);
+        struct dump dump;
+        if (load_dump(path, &dump)) {
+            entry->signature = strdup("unreadable");
+            continue;
+        }
+        walk_frames(&dump);
+        entry->signature = dump_signature(&dump, triage->binary, triage->syms);
+        unload_dump(&dump);
+    }
+    return NULL;
+}
+
+// The index caches signatures as "name size mtime signature" lines, so only
+// new or changed dumps are processed again. Signatures depend on the binary
+// they were symbolized with, so its path, size and mtime head the index, and
+// the whole cache is dropped when they change.
+static void load_index(struct triage *triage, const char *index_path) {
+    FILE *index = fopen(index_path, "r");
+    if (index == NULL) {
+        return;
+    }
+
+    char line[SIGNATURE_LEN + 1024];
+    char header[sizeof(line)];
+    snprintf(header, sizeof(header), "binary\t%s\t%" PRIu64 "\t%" PRId64 "\n",
+             triage->binary, triage->binary_size, triage->binary_mtime);
+    if (fgets(line, sizeof(line), index) == NULL || strcmp(line, header)) {
+        fclose(index);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), index) != NULL) {
+        char *name = strtok(line, "\t");
+        char *size = strtok(NULL, "\t");
+        char *mtime = strtok(NULL, "\t");
+        char *signature = strtok(NULL, "\n");
+        if (name == NULL || size == NULL || mtime == NULL || signature == NULL) {
+            continue;
+        }
+        for (size_t i = 0; i < triage->count; i++) {
+            struct triage_entry *entry = &triage->entries[i];
+            if (entry->signature == NULL && !strcmp(entry->name, name) &&
+                entry->size == strtoull(size, NULL, 10) &&
+                entry->mtime == strtoll(mtime, NULL, 10)) {
+                // Left NULL if this fails, so the dump is just processed.
+                entry->signature = strdup(signature);
+                break;
+            }
+        }
+    }
+    fclose(index);
+}
+
+static void save_index(struct triage *triage, const char *index_path) {
+    FILE *index = fopen(index_path, "w");
+    if (index == NULL) {
+        perror("dumper: could not write the index");
+        return;
+    }
+    fprintf(index, "binary\t%s\t%" PRIu64 "\t%" PRId64 "\n", triage->binary,
+            triage->binary_size, triage->binary_mtime);
+    for (size_t i = 0; i < triage->count; i++) {
+        struct triage_entry *entry = &triage->entries[i];
+        fprintf(index, "%s\t%" PRIu64 "\t%" PRId64 "\t%s\n", entry->name, entry->size,
+                entry->mtime, entry->signature);
+    }
+    fclose(index);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const struct triage_entry *ea = a, *eb = b;
+    int ret = strcmp(ea->signature, eb->signature);
+    return ret != 0 ? ret : strcmp(ea->name, eb->name);
+}
+
+struct triage_group {
+    size_t first;
+    size_t count;
+};
+
+static int compare_groups(const void *a, const void *b) {
+    const struct triage_group *ga = a, *gb = b;
+    if (ga->count != gb->count) {
+        return ga->count > gb->count ? -1 : 1;
+    }
+    return 0;
+}
+
+static int triage_dir(const char *dir_path, const char *index_path, const char *binary,
+                      struct elf_symbols *syms, long jobs) {
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL) {
+        perror("dumper: could not open directory");
+        return 1;
+    }
+
+    // The index may live among the dumps, do not take it for one.
+    struct stat index_st;
+    bool has_index = index_path != NULL && !stat(index_path, &index_st);
+
+    struct triage triage = {.dir = dir_path, .binary = binary, .syms = syms};
+    struct stat binary_st;
+    if (!stat(binary, &binary_st)) {
+        triage.binary_size = binary_st.st_size;
+        triage.binary_mtime = binary_st.st_mtime;
+    }
+    struct dirent *ent;
+    char path[1024];
+    while ((ent = readdir(dir)) != NULL) {
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir_path, ent->d_name);
+        if (ent->d_name[0] == '.' || stat(path, &st) || !S_ISREG(st.st_mode) ||
+            (has_index && st.st_dev == index_st.st_dev && st.st_ino == index_st.st_ino)) {
+            continue;
+        }
+
+        triage.entries = realloc(triage.entries, (triage.count + 1) * sizeof(struct triage_entry));
+        if (triage.entries == NULL) {
+            perror("dumper: could not allocate");
+            return 1;
+        }
+        triage.entries[triage.count].name = strdup(ent->d_name);
+        if (triage.entries[triage.count].name == NULL) {
+            perror("dumper: could not allocate");
+            return 1;
+        }
+        triage.entries[triage.count].size = st.st_size;
+        triage.entries[triage.count].mtime = st.st_mtime;
+        triage.entries[triage.count].signature = NULL;
+        triage.count++;
+    }
+    closedir(dir);
+
+    if (index_path != NULL) {
+        load_index(&triage, index_path);
+    }
+
+    pthread_t *workers = malloc(jobs * sizeof(pthread_t));
+    if (workers == NULL) {
+        perror("dumper: could not allocate");
+        return 1;
+    }
+    atomic_init(&triage.next, 0);
+    long started = 0;
+    for (; started < jobs; started++) {
+        if (pthread_create(&workers[started], NULL, triage_worker, &triage)) {
+            break;
+        }
+    }
+    if (started == 0) {
+        triage_worker(&triage);
+    }
+    for (long i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    // Workers leave the signatures they could not allocate NULL.
+    for (size_t i = 0; i < triage.count; i++) {
+        if (triage.entries[i].signature == NULL) {
+            fprintf(stderr, "dumper: could not allocate\n");
+            return 1;
+        }
+    }
+
+    if (index_path != NULL) {
+        save_index(&triage, index_path);
+    }
+
+    // Sort by signature so groups are contiguous, then rank the groups.
+    qsort(triage.entries, triage.count, sizeof(struct triage_entry), compare_entries);
+    size_t group_count = 0;
+    struct triage_group *groups = malloc((triage.count + 1) * sizeof(struct triage_group));
+    if (groups == NULL) {
+        perror("dumper: could not allocate");
+        return 1;
+    }
+    for (size_t i = 0; i < triage.count; i++) {
+        if (i == 0 || strcmp(triage.entries[i].signature, triage.entries[i - 1].signature)) {
+            groups[group_count].first = i;
+            groups[group_count].count = 0;
+            group_count++;
+        }
+        groups[group_count - 1].count++;
+    }
+    qsort(groups, group_count, sizeof(struct triage_group), compare_groups);
+
+    printf("%zu dumps, %zu distinct crashes\n", triage.count, group_count);
+    printf("%6s %-30s %s\n", "COUNT", "EXAMPLE", "SIGNATURE");
+    for (size_t i = 0; i < group_count; i++) {
+        struct triage_entry *example = &triage.entries[groups[i].first];
+        printf("%6zu %-30s %s\n", groups[i].count, example->name, example->signature);
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     char c;
     char *corefile = NULL;
-    while ((c = getopt (argc, argv, "hv")) != -1) {
+    char *executable = NULL;
+    char *directory = NULL;
+    char *index_path = NULL;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((c = getopt (argc, argv, "hve:d:i:j:")) != -1) {
         switch (c) {
             case 'h':
                 puts("Usage: dumper [options] <filename>");
+                puts("       dumper [options] -d <directory>");
                 puts("");
                 puts("Options:");
-                puts("-h Print this help message");
-                puts("-v Display version information.");
+                puts("-h        Print this help message");
+                puts("-v        Display version information.");
+                puts("-e <path> Executable that faulted, for symbolization");
+                puts("-d <dir>  Group all the dumps in a directory by fault signature");
+                puts("-i <file> With -d, cache signatures in an index file");
+                puts("-j <n>    With -d, worker threads to use, online CPUs by default");
                 return 0;
             case 'v':
                puts("dumper" VERSION_STR);
                return 0;
+            case 'e':
+                executable = strdup(optarg);
+                break;
+            case 'd':
+                directory = strdup(optarg);
+                break;
+            case 'i':
+                index_path = strdup(optarg);
+                break;
+            case 'j':
+                if (sscanf(optarg, "%ld", &jobs) != 1 || jobs <= 0) {
+                    fprintf(stderr, "dumper: '%s' is not a valid job count\n", optarg);
+                    return 1;
+                }
+                break;
             default:
+                if (optopt == 'e' || optopt == 'd' || optopt == 'i' || optopt == 'j') {
+                    fprintf(stderr, "dumper: %c needs an argument\n", optopt);
+                    return 1;
+                }
                 goto END_WHILE;
         }
     }
@@ -82,27 +464,41 @@ END_WHILE:
         }
     }
 
-    if (corefile == NULL) {
+    if (corefile == NULL && directory == NULL) {
         fprintf(stderr, "dumper: No file for dumping was passed\n");
         return 1;
     }
 
-    struct registers *contents = malloc(sizeof(struct registers));
-    if (contents == NULL) {
-        perror("dumper: could not allocate");
-        return 1;
+    struct elf_symbols symbols;
+    struct elf_symbols *syms = NULL;
+    if (executable != NULL) {
+        if (elfsym_load(&symbols, executable)) {
+            fprintf(stderr, "dumper: could not load symbols of '%s'\n", executable);
+        } else if (symbols.is_pie) {
+            fprintf(stderr, "dumper: '%s' is position independent, not symbolizing\n", executable);
+        } else {
+            syms = &symbols;
+        }
     }
 
-    int core_fd = open(corefile, O_RDONLY);
-    if (core_fd == -1) {
-        perror("dumper: could not open passed file");
-        return 1;
+    if (directory != NULL) {
+        if (jobs <= 0) {
+            jobs = 1;
+        }
+        return triage_dir(directory, index_path, executable != NULL ? executable : "?",
+                          syms, jobs);
     }
 
-    if (read(core_fd, contents, sizeof(struct registers)) != sizeof(struct registers)) {
-        perror("dumper: could not read enough of the dump");
+    struct dump dump;
+    int loaded = load_dump(corefile, &dump);
+    if (loaded == DUMP_TOO_SHORT) {
+        fprintf(stderr, "dumper: '%s' is too short to be a dump\n", corefile);
+        return 1;
+    } else if (loaded != 0) {
+        perror("dumper: could not read the dump");
         return 1;
     }
+    struct registers *contents = &dump.regs;
 
     printf("Register dump at the time of fault (%" PRIx64 "):\n", contents->rip);
     printf("RAX: %016" PRIx64 " RBX: %016" PRIx64 " RCX: %016" PRIx64 "\n", contents->rax, contents->rbx, contents->rcx);
@@ -113,4 +509,15 @@ END_WHILE:
     printf("\n");
     printf("ERR: %" PRIx64 " CS: %" PRIx64 " RFLAGS: %" PRIx64 "\n", contents->err, contents->cs, contents->rflags);
     printf("RSP: %" PRIx64 " SS: %" PRIx64 "\n", contents->rsp, contents->ss);
+
+    walk_frames(&dump);
+    printf("\n");
+    printf("Backtrace (%zu bytes of stack dumped):\n", dump.stack_len);
+    for (int i = 0; i < dump.frame_count; i++) {
+        printf("#%-2d ", i);
+        print_address(syms, dump.frames[i]);
+    }
+
+    unload_dump(&dump);
+    return 0;
 }
@@ -0,0 +1,174 @@
+/*
+    elfsym.h: Symbolization of addresses using the symbols of ELF files.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The file is mapped and kept mapped, names point straight into it, and the
+// function symbols of symtab and dynsym are kept sorted by address in order
+// to binary search them.
+struct elf_symbol {
+    uint64_t addr;
+    uint64_t size;
+    const char *name;
+};
+
+struct elf_symbols {
+    void *map;
+    size_t map_size;
+    bool is_pie;
+    size_t count;
+    struct elf_symbol *symbols;
+};
+
+static inline int elfsym_compare(const void *a, const void *b) {
+    const struct elf_symbol *sa = a, *sb = b;
+    if (sa->addr != sb->addr) {
+        return sa->addr < sb->addr ? -1 : 1;
+    }
+    return 0;
+}
+
+static inline void elfsym_add_table(struct elf_symbols *syms, const Elf64_Shdr *sects,
+                                    uint16_t sect_count, const Elf64_Shdr *table) {
+    if (table->sh_link >= sect_count || table->sh_entsize != sizeof(Elf64_Sym) ||
+        table->sh_offset + table->sh_size > syms->map_size) {
+        return;
+    }
+
+    const Elf64_Shdr *strtab = &sects[table->sh_link];
+    if (strtab->sh_offset + strtab->sh_size > syms->map_size) {
+        return;
+    }
+
+    const char *strings = (const char *)syms->map + strtab->sh_offset;
+    const Elf64_Sym *entries = (const Elf64_Sym *)((const char *)syms->map + table->sh_offset);
+    size_t entry_count = table->sh_size / sizeof(Elf64_Sym);
+
+    struct elf_symbol *grown = realloc(syms->symbols,
+        (syms->count + entry_count) * sizeof(struct elf_symbol));
+    if (grown == NULL) {
+        return;
+    }
+    syms->symbols = grown;
+
+    for (size_t i = 0; i < entry_count; i++) {
+        if (ELF64_ST_TYPE(entries[i].st_info) != STT_FUNC ||
+            entries[i].st_value == 0 || entries[i].st_name >= strtab->sh_size) {
+            continue;
+        }
+        syms->symbols[syms->count].addr = entries[i].st_value;
+        syms->symbols[syms->count].size = entries[i].st_size;
+        syms->symbols[syms->count].name = strings + entries[i].st_name;
+        syms->count++;
+    }
+}
+
+// Load the symbols of an ELF file, returns 0 on success.
+static inline int elfsym_load(struct elf_symbols *syms, const char *path) {
+    memset(syms, 0, sizeof(struct elf_symbols));
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(Elf64_Ehdr)) {
+        close(fd);
+        return -1;
+    }
+
+    syms->map_size = st.st_size;
+    syms->map = mmap(NULL, syms->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (syms->map == MAP_FAILED) {
+        syms->map = NULL;
+        return -1;
+    }
+
+    const Elf64_Ehdr *header = syms->map;
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) ||
+        header->e_ident[EI_CLASS] != ELFCLASS64 ||
+        header->e_shentsize != sizeof(Elf64_Shdr) ||
+        header->e_shoff + (uint64_t)header->e_shnum * sizeof(Elf64_Shdr) > syms->map_size) {
+        munmap(syms->map, syms->map_size);
+        syms->map = NULL;
+        return -1;
+    }
+
+    syms->is_pie = header->e_type == ET_DYN;
+    const Elf64_Shdr *sects = (const Elf64_Shdr *)((const char *)syms->map + header->e_shoff);
+    for (uint16_t i = 0; i < header->e_shnum; i++) {
+        if (sects[i].sh_type == SHT_SYMTAB || sects[i].sh_type == SHT_DYNSYM) {
+            elfsym_add_table(syms, sects, header->e_shnum, &sects[i]);
+        }
+    }
+
+    // dynsym duplicates part of symtab, so sort and drop repeated addresses.
+    qsort(syms->symbols, syms->count, sizeof(struct elf_symbol), elfsym_compare);
+    size_t kept = 0;
+    for (size_t i = 0; i < syms->count; i++) {
+        if (kept == 0 || syms->symbols[kept - 1].addr != syms->symbols[i].addr) {
+            syms->symbols[kept++] = syms->symbols[i];
+        }
+    }
+    syms->count = kept;
+    return 0;
+}
+
+// Find the function containing an address, NULL if none does.
+static inline const struct elf_symbol *elfsym_lookup(const struct elf_symbols *syms,
+                                                     uint64_t addr) {
+    size_t low = 0, high = syms->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (syms->symbols[mid].addr <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == 0) {
+        return NULL;
+    }
+
+    // Symbols without a size are taken to run until the next one.
+    const struct elf_symbol *sym = &syms->symbols[low - 1];
+    if (sym->size != 0 && addr >= sym->addr + sym->size) {
+        return NULL;
+    }
+    return sym;
+}
+
+static inline void elfsym_free(struct elf_symbols *syms) {
+    if (syms->map != NULL) {
+        munmap(syms->map, syms->map_size);
+    }
+    free(syms->symbols);
+    memset(syms, 0, sizeof(struct elf_symbols));
+}
@@ -0,0 +1,55 @@
+/*
+    execpath.h: Finding the executable a command name refers to.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Find what execvp would run for name, going through PATH unless the name
+// has a slash. Returns an allocated path, or NULL if there is none.
+static inline char *execpath_find(const char *name) {
+    if (strchr(name, '/') != NULL) {
+        return strdup(name);
+    }
+
+    const char *path = getenv("PATH");
+    if (path == NULL) {
+        path = "/bin:/usr/bin";
+    }
+    while (*path != '\0') {
+        const char *end = strchr(path, ':');
+        size_t len = end == NULL ? strlen(path) : (size_t)(end - path);
+        char *candidate = malloc(len + strlen(name) + 2);
+        if (candidate == NULL) {
+            return NULL;
+        }
+        sprintf(candidate, "%.*s/%s", (int)len, path, name);
+        if (!access(candidate, X_OK)) {
+            return candidate;
+        }
+        free(candidate);
+        path += len;
+        if (*path == ':') {
+            path++;
+        }
+    }
+    return NULL;
+}
@@ -27,18 +27,7 @@
 #include <sys/syscall.h>
 #include <stdbool.h>
 #include <fcntl.h>
-
-#define NETINTER_BLOCKED 0b1
-
-struct netinterface {
-    char devname[65];
-    uint64_t flags;
-    uint8_t mac_addr[6];
-    uint8_t ipv4_addr[4];
-    uint8_t ipv4_subnet[4];
-    uint8_t ipv6_addr[16];
-    uint8_t ipv6_subnet[16];
-} __attribute__((packed));
+#include <sysinfo.h>
 
 static int ipv6addr_is_not_zero(uint8_t *addr) {
     for (int i = 0; i < 16; i++) {
@@ -119,14 +108,13 @@ int main(int argc, char *argv[]) {
         return errno;
     }
 
-    struct netinterface *buffer = malloc(10 * sizeof(struct netinterface));
-    long ret, errno;
-    SYSCALL2(SYSCALL_LISTNETINTER, buffer, 10);
-    if (ret == -1) {
+    struct sysinfo_list list = {0};
+    if (sysinfo_fetch(&list, SYSCALL_LISTNETINTER, sizeof(struct netinterface))) {
         return 1;
     }
 
-    for (int i = 0; i < ret; i++) {
+    struct netinterface *buffer = list.items;
+    for (size_t i = 0; i < list.count; i++) {
         printf("%s: <%s>\n", buffer[i].devname, buffer[i].flags & NETINTER_BLOCKED ? "BLOCKED" : "UNBLOCKED");
         printf("\tether %02x:%02x:%02x:%02x:%02x:%02x\n",
                buffer[i].mac_addr[0], buffer[i].mac_addr[1],
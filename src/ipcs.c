@@ -23,17 +23,7 @@
 #include <commons.h>
 #include <inttypes.h>
 #include <sys/syscall.h>
-
-#define MODE_WRITE 0b1
-
-struct flockinfo {
-    uint32_t pid;
-    uint32_t mode;
-    uint64_t start;
-    uint64_t length;
-    uint64_t fs;
-    uint64_t ino;
-} __attribute__((packed));
+#include <sysinfo.h>
 
 int main(int argc, char *argv[]) {
     int do_shared_segments = 1;
@@ -74,19 +64,7 @@ int main(int argc, char *argv[]) {
     }
 
     if (do_shared_segments) {
-        // In Ironclad, shmids go from 1 to X, where X is 20 for current releases.
-        // So we can just iterate that.
-        struct shmid_ds buf;
-        puts("Shared Memory Segments:");
-        printf("%10s %5s %10s %10s %10s %6s\n", "key", "shmid", "owner", "perms",
-            "bytes", "nattach");
-        for (int i = 1; i <= 20; i++) {
-            if (!shmctl(i, IPC_STAT, &buf)) {
-                printf("%010d %5d %10d %10o %10zu %6ld\n", buf.shm_perm.__ipc_perm_key,
-                    i, buf.shm_perm.uid, buf.shm_perm.mode, buf.shm_segsz,
-                    buf.shm_nattch);
-            }
-        }
+        sysinfo_print_shm(stdout);
     }
 
     if (do_filelocks) {
@@ -94,19 +72,10 @@ int main(int argc, char *argv[]) {
             puts("");
         }
 
-        int ret, errno;
-        struct flockinfo *buffer = malloc(20 * sizeof(struct flockinfo));
-        SYSCALL2(SYSCALL_LISTFLOCKS, buffer, 20);
-        if (ret == -1) {
+        struct sysinfo_list flocks = {0};
+        if (sysinfo_fetch(&flocks, SYSCALL_LISTFLOCKS, sizeof(struct flockinfo))) {
             return 1;
         }
-
-        puts("POSIX filelocks:");
-        printf("%4s %4s %20s %20s %10s %10s\n", "PID", "MODE", "START", "LENGTH", "FS", "INO");
-        for (int i = 0; i < ret; i++) {
-            printf("%4" PRIu32 " %4s %20" PRIu64 " %20" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
-                   buffer[i].pid, buffer[i].mode == MODE_WRITE ? "W" : "R",
-                   buffer[i].start, buffer[i].length, buffer[i].fs, buffer[i].ino);
-        }
+        sysinfo_print_flocks(stdout, &flocks);
     }
 }
@@ -0,0 +1,192 @@
+/*
+    klog.h: Fetching and parsing of the kernel logs.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <sys/syscall.h>
+
+// The kernel hands out its logs as fixed size lines, used ones start with '('.
+#define KLOG_LINE_LEN 80
+#define KLOG_INITIAL_LINES 100
+#define KLOG_MAX_SIZE (1024 * 1024)
+
+// Fetch the logs, growing the buffer for as long as the kernel fills it, so
+// its size is whatever the kernel has and not what we guessed.
+static inline char *klog_fetch(char *logs, size_t *length) {
+    for (;;) {
+        // Slots the kernel does not fill must not keep stale lines around.
+        memset(logs, 0, *length);
+
+        long ret, errno;
+        SYSCALL2(SYSCALL_DUMPLOGS, logs, *length);
+        if (ret == -1) {
+            return NULL;
+        }
+        if ((size_t)ret < *length || *length >= KLOG_MAX_SIZE) {
+            return logs;
+        }
+
+        *length *= 2;
+        logs = realloc(logs, *length);
+        if (logs == NULL) {
+            return NULL;
+        }
+    }
+}
+
+static inline uint64_t klog_hash_line(const char *line) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < KLOG_LINE_LEN && line[i] != '\0'; i++) {
+        hash = (hash ^ (unsigned char)line[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+
+// Lines are parsed once into slices of the dump itself, they look like
+// "(<seconds since boot>) [<subsystem>: ]<message>".
+struct klog_record {
+    const char *line;
+    int line_len;
+    double seconds;
+    const char *stamp;
+    int stamp_len;
+    const char *subsystem;
+    int subsystem_len;
+    const char *message;
+    int message_len;
+    int level;
+};
+
+// The kernel does not tag its lines with levels, so guess from the wording.
+enum log_level {KLOG_LEVEL_CRIT, KLOG_LEVEL_ERR, KLOG_LEVEL_WARN, KLOG_LEVEL_INFO, KLOG_LEVEL_COUNT};
+static const char *klog_level_names[KLOG_LEVEL_COUNT] = {"crit", "err", "warn", "info"};
+
+static inline bool klog_contains(const char *str, int len, const char *word) {
+    size_t word_len = strlen(word);
+    for (int i = 0; i + (int)word_len <= len; i++) {
+        if (!strncasecmp(str + i, word, word_len)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline int klog_guess_level(const char *message, int len) {
+    if (klog_contains(message, len, "panic") || klog_contains(message, len, "fatal")) {
+        return KLOG_LEVEL_CRIT;
+    } else if (klog_contains(message, len, "error") || klog_contains(message, len, "fail") ||
+               klog_contains(message, len, "could not")) {
+        return KLOG_LEVEL_ERR;
+    } else if (klog_contains(message, len, "warn")) {
+        return KLOG_LEVEL_WARN;
+    }
+    return KLOG_LEVEL_INFO;
+}
+
+static inline void klog_parse_line(const char *line, struct klog_record *rec) {
+    int len = strnlen(line, KLOG_LINE_LEN);
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\n')) {
+        len--;
+    }
+    rec->line = line;
+    rec->line_len = len;
+
+    // Timestamp, which we parse by hand as the slice is not terminated.
+    int i = 1;
+    rec->stamp = line + 1;
+    rec->seconds = 0;
+    double scale = 0;
+    for (; i < len && line[i] != ')'; i++) {
+        if (line[i] >= '0' && line[i] <= '9') {
+            if (scale == 0) {
+                rec->seconds = rec->seconds * 10 + (line[i] - '0');
+            } else {
+                rec->seconds += (line[i] - '0') * scale;
+                scale /= 10;
+            }
+        } else if (line[i] == '.') {
+            scale = 0.1;
+        }
+    }
+    rec->stamp_len = i - 1;
+    i++;
+    while (i < len && line[i] == ' ') {
+        i++;
+    }
+
+    // A subsystem is a single word followed by a colon.
+    rec->subsystem = line + i;
+    rec->subsystem_len = 0;
+    for (int j = i; j < len && line[j] != ' '; j++) {
+        if (line[j] == ':') {
+            rec->subsystem_len = j - i;
+            i = j + 1;
+            while (i < len && line[i] == ' ') {
+                i++;
+            }
+            break;
+        }
+    }
+
+    rec->message = line + i;
+    rec->message_len = len > i ? len - i : 0;
+    rec->level = klog_guess_level(rec->message, rec->message_len);
+}
+
+// Where to pick up from, the hash of the last line seen. When that line is
+// gone from the dump because the kernel ring wrapped past it, lost is set.
+struct klog_cursor {
+    uint64_t hash;
+    bool valid;
+    bool lost;
+};
+
+// Parse all the used lines past the one the cursor hashes to, which is
+// searched from the end, all of them if it is gone, and move the cursor to
+// the last one. records must have room for length / KLOG_LINE_LEN entries.
+static inline size_t klog_parse_new(const char *logs, size_t length, struct klog_cursor *cursor,
+                                    struct klog_record *records) {
+    size_t start = 0;
+    cursor->lost = false;
+    if (cursor->valid) {
+        cursor->lost = true;
+        for (size_t i = length / KLOG_LINE_LEN; i > 0; i--) {
+            const char *line = logs + (i - 1) * KLOG_LINE_LEN;
+            if (line[0] == '(' && klog_hash_line(line) == cursor->hash) {
+                start = i * KLOG_LINE_LEN;
+                cursor->lost = false;
+                break;
+            }
+        }
+    }
+
+    size_t count = 0;
+    for (size_t i = start; i + KLOG_LINE_LEN <= length; i += KLOG_LINE_LEN) {
+       if (logs[i] == '(') {
+           klog_parse_line(logs + i, &records[count++]);
+           cursor->hash = klog_hash_line(logs + i);
+           cursor->valid = true;
+       }
+    }
+    return count;
+}
@@ -0,0 +1,132 @@
+/*
+    klogd.c: Forward kernel logs to syslog.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <time.h>
+#include <syslog.h>
+#include <commons.h>
+#include <klog.h>
+
+// Polling starts fast and doubles for every fetch that brings nothing new,
+// going back to the fastest rate as soon as the kernel logs something.
+#define MIN_INTERVAL_MS 250
+#define DEFAULT_MAX_INTERVAL_MS 8000
+
+static const int level_priorities[KLOG_LEVEL_COUNT] = {
+    [KLOG_LEVEL_CRIT] = LOG_CRIT,
+    [KLOG_LEVEL_ERR]  = LOG_ERR,
+    [KLOG_LEVEL_WARN] = LOG_WARNING,
+    [KLOG_LEVEL_INFO] = LOG_INFO
+};
+
+int main(int argc, char *argv[]) {
+    bool foreground = false;
+    long max_interval = DEFAULT_MAX_INTERVAL_MS;
+
+    char c;
+    while ((c = getopt(argc, argv, "hvfi:")) != -1) {
+        switch (c) {
+            case 'h':
+                puts("Usage: klogd [options]");
+                puts("");
+                puts("Options:");
+                puts("-h              Print this help message");
+                puts("-v              Display version information.");
+                puts("-f              Stay in the foreground");
+                puts("-i <ms>         Longest wait between polls of a quiet log");
+                return 0;
+            case 'v':
+               puts("klogd" VERSION_STR);
+               return 0;
+            case 'f':
+               foreground = true;
+               break;
+            case 'i': {
+               char *end;
+               max_interval = strtol(optarg, &end, 10);
+               if (*optarg == '\0' || *end != '\0') {
+                   fprintf(stderr, "klogd: '%s' is not a valid interval\n", optarg);
+                   return 1;
+               } else if (max_interval < MIN_INTERVAL_MS) {
+                   fprintf(stderr, "klogd: interval must be at least %d ms\n", MIN_INTERVAL_MS);
+                   return 1;
+               }
+               break;
+            }
+            default:
+                fprintf(stderr, "klogd: %c is not a valid argument\n", optopt);
+                return 1;
+        }
+    }
+
+    size_t length = KLOG_INITIAL_LINES * KLOG_LINE_LEN;
+    char *logs = malloc(length);
+    struct klog_record *records = NULL;
+    if (logs == NULL) {
+        perror("klogd: Could not allocate the log buffer");
+        return 1;
+    }
+
+    if (!foreground && daemon(0, 0)) {
+        perror("klogd: Could not daemonize");
+        return 1;
+    }
+
+    // One connection for the lifetime of the daemon instead of one per line.
+    openlog("kernel", LOG_NDELAY, LOG_KERN);
+
+    struct klog_cursor cursor = {0};
+    long interval = MIN_INTERVAL_MS;
+    for (;;) {
+        logs = klog_fetch(logs, &length);
+        if (logs == NULL) {
+            syslog(LOG_ERR, "klogd: Could not fetch the kernel logs");
+            return 1;
+        }
+
+        records = realloc(records, (length / KLOG_LINE_LEN) * sizeof(struct klog_record));
+        if (records == NULL) {
+            syslog(LOG_ERR, "klogd: Could not allocate the record buffer");
+            return 1;
+        }
+
+        size_t count = klog_parse_new(logs, length, &cursor, records);
+        if (cursor.lost) {
+            syslog(LOG_WARNING, "klogd: Kernel log wrapped, some messages were lost");
+        }
+        for (size_t i = 0; i < count; i++) {
+            syslog(level_priorities[records[i].level], "%.*s",
+                   records[i].line_len, records[i].line);
+        }
+
+        if (count != 0) {
+            interval = MIN_INTERVAL_MS;
+        } else if (interval < max_interval) {
+            interval = interval * 2 < max_interval ? interval * 2 : max_interval;
+        }
+
+        struct timespec wait = {
+            .tv_sec  = interval / 1000,
+            .tv_nsec = (interval % 1000) * 1000000
+        };
+        nanosleep(&wait, NULL);
+    }
+}
@@ -22,36 +22,225 @@
 #include <sys/mac.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <commons.h>
 #include <syslog.h>
 
+// Streamed input is read in blocks of this size, lines longer than a block
+// are sent in pieces.
+#define STREAM_BLOCK_SIZE (64 * 1024)
+
+struct priority_name {
+    const char *name;
+    int value;
+};
+
+static const struct priority_name facility_names[] = {
+    {"kern",     LOG_KERN},
+    {"user",     LOG_USER},
+    {"mail",     LOG_MAIL},
+    {"daemon",   LOG_DAEMON},
+    {"auth",     LOG_AUTH},
+    {"syslog",   LOG_SYSLOG},
+    {"lpr",      LOG_LPR},
+    {"news",     LOG_NEWS},
+    {"uucp",     LOG_UUCP},
+    {"cron",     LOG_CRON},
+    {"authpriv", LOG_AUTHPRIV},
+    {"local0",   LOG_LOCAL0},
+    {"local1",   LOG_LOCAL1},
+    {"local2",   LOG_LOCAL2},
+    {"local3",   LOG_LOCAL3},
+    {"local4",   LOG_LOCAL4},
+    {"local5",   LOG_LOCAL5},
+    {"local6",   LOG_LOCAL6},
+    {"local7",   LOG_LOCAL7},
+    {NULL,       0}
+};
+
+static const struct priority_name level_names[] = {
+    {"emerg",   LOG_EMERG},
+    {"panic",   LOG_EMERG},
+    {"alert",   LOG_ALERT},
+    {"crit",    LOG_CRIT},
+    {"err",     LOG_ERR},
+    {"error",   LOG_ERR},
+    {"warning", LOG_WARNING},
+    {"warn",    LOG_WARNING},
+    {"notice",  LOG_NOTICE},
+    {"info",    LOG_INFO},
+    {"debug",   LOG_DEBUG},
+    {NULL,      0}
+};
+
+static int lookup_name(const struct priority_name *names, const char *name, size_t len) {
+    for (int i = 0; names[i].name != NULL; i++) {
+        if (strlen(names[i].name) == len && !strncmp(names[i].name, name, len)) {
+            return names[i].value;
+        }
+    }
+    return -1;
+}
+
+// Parse a priority of the form [facility.]level, returns -1 on failure.
+static int parse_priority(const char *str) {
+    int facility = LOG_USER;
+    const char *level = str;
+    const char *dot = strchr(str, '.');
+    if (dot != NULL) {
+        facility = lookup_name(facility_names, str, dot - str);
+        level = dot + 1;
+    }
+
+    int value = lookup_name(level_names, level, strlen(level));
+    if (facility == -1 || value == -1) {
+        return -1;
+    }
+    return facility | value;
+}
+
+// Send every line of a file as its own message. Lines are split in place in
+// a single block buffer, with whatever partial line is left at the end of a
+// block moved to the front before reading the next one.
+static int stream_lines(int fd, int priority) {
+    char *block = malloc(STREAM_BLOCK_SIZE + 1);
+    if (block == NULL) {
+        perror("logger: Could not allocate the input buffer");
+        return 1;
+    }
+
+    size_t pending = 0;
+    for (;;) {
+        ssize_t count = read(fd, block + pending, STREAM_BLOCK_SIZE - pending);
+        if (count == -1 && errno == EINTR) {
+            continue;
+        } else if (count == -1) {
+            perror("logger: Could not read input");
+            free(block);
+            return 1;
+        }
+
+        size_t filled = pending + count;
+        size_t start = 0;
+        for (;;) {
+            char *newline = memchr(block + start, '\n', filled - start);
+            if (newline == NULL) {
+                break;
+            }
+            *newline = '\0';
+            if (newline != block + start) {
+                syslog(priority, "%s", block + start);
+            }
+            start = newline - block + 1;
+        }
+
+        // Flush what is left when it fills the block or the input is over.
+        if (count == 0 || (start == 0 && filled == STREAM_BLOCK_SIZE)) {
+            if (filled != start) {
+                block[filled] = '\0';
+                syslog(priority, "%s", block + start);
+            }
+            start = filled;
+        }
+
+        pending = filled - start;
+        memmove(block, block + start, pending);
+        if (count == 0) {
+            break;
+        }
+    }
+
+    free(block);
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
-    size_t total_size = 0;
-    for (int i = 1; i < argc; i++) {
-        if (!strcmp(argv[i], "-h")) {
-            puts("Usage: logger [options] ...");
-            puts("");
-            puts("Options:");
-            puts("-h            Print this help message");
-            puts("-v            Print version information");
-            return 0;
-        } else if (!strcmp(argv[i], "-v")) {
-            puts("logger" VERSION_STR);
-            return 0;
+    const char *tag = "logger";
+    const char *file = NULL;
+    bool from_stdin = false;
+    int priority = LOG_USER | LOG_INFO;
+
+    char c;
+    while ((c = getopt(argc, argv, "hvst:p:f:")) != -1) {
+        switch (c) {
+            case 'h':
+                puts("Usage: logger [options] [message ...]");
+                puts("");
+                puts("Options:");
+                puts("-h            Print this help message");
+                puts("-v            Print version information");
+                puts("-s            Log every line of stdin, the default without a message");
+                puts("-t <tag>      Tag every message with tag instead of 'logger'");
+                puts("-p <prio>     Log with the [facility.]level priority, user.info by default");
+                puts("-f <file>     Log every line of file");
+                return 0;
+            case 'v':
+                puts("logger" VERSION_STR);
+                return 0;
+            case 's':
+                from_stdin = true;
+                break;
+            case 't':
+                tag = optarg;
+                break;
+            case 'p':
+                priority = parse_priority(optarg);
+                if (priority == -1) {
+                    fprintf(stderr, "logger: '%s' is not a valid priority\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f':
+                file = optarg;
+                break;
+            default:
+                fprintf(stderr, "logger: %c is not a valid argument\n", optopt);
+                return 1;
+        }
+    }
+
+    // The facility is passed along with every message, so openlog does not
+    // need it, just to connect right away and keep the connection.
+    openlog(tag, LOG_NDELAY, LOG_USER);
+
+    int ret = 0;
+    if (file != NULL) {
+        int fd = open(file, O_RDONLY);
+        if (fd == -1) {
+            perror("logger: Could not open file");
+            ret = 1;
         } else {
+            ret = stream_lines(fd, priority);
+            close(fd);
+        }
+    } else if (from_stdin || optind == argc) {
+        ret = stream_lines(STDIN_FILENO, priority);
+    } else {
+        size_t total_size = 0;
+        for (int i = optind; i < argc; i++) {
             total_size += strlen(argv[i]) + 1;
         }
-    }
 
-    char *total_string = calloc(1, total_size + 1);
-    for (int i = 1; i < argc; i++) {
-        strcat(total_string, argv[i]);
-        strcat(total_string, " ");
+        char *total_string = malloc(total_size);
+        if (total_string == NULL) {
+            perror("logger: Could not allocate the message");
+            return 1;
+        }
+        size_t offset = 0;
+        for (int i = optind; i < argc; i++) {
+            size_t len = strlen(argv[i]);
+            memcpy(total_string + offset, argv[i], len);
+            total_string[offset + len] = ' ';
+            offset += len + 1;
+        }
+        total_string[total_size - 1] = '\0';
+
+        syslog(priority, "%s", total_string);
+        free(total_string);
     }
-    total_string[total_size - 1] = '\0';
 
-    openlog("logger", 0, LOG_USER);
-    syslog(LOG_INFO, "%s", total_string);
     closelog();
-    free(total_string);
+    return ret;
 }
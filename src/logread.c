@@ -0,0 +1,149 @@
+/*
+    logread.c: Read the messages stored by syslogd.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <time.h>
+#include <commons.h>
+#include <logstore.h>
+
+#define FOLLOW_INTERVAL_MS 250
+
+static const char *level_names[8] = {
+    "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"
+};
+
+static void print_record(const struct logstore_record *rec) {
+    const char *payload = (const char *)(rec + 1);
+    time_t secs = rec->time / 1000000000LL;
+    struct tm tm;
+    char stamp[32];
+    localtime_r(&secs, &tm);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+
+    printf("%s %-7s ", stamp, level_names[rec->priority & 7]);
+    if (rec->tag_len != 0) {
+        printf("%.*s: ", rec->tag_len, payload);
+    }
+    printf("%.*s\n", rec->message_len, payload + rec->tag_len);
+}
+
+int main(int argc, char *argv[]) {
+    const char *store_path = LOGSTORE_DEFAULT_PATH;
+    long tail = -1;
+    bool has_since = false;
+    int64_t since = 0;
+    bool follow = false;
+
+    char c;
+    while ((c = getopt(argc, argv, "hvo:n:s:F")) != -1) {
+        switch (c) {
+            case 'h':
+                puts("Usage: logread [options]");
+                puts("");
+                puts("Options:");
+                puts("-h              Print this help message");
+                puts("-v              Display version information.");
+                puts("-o <path>       Read the store at path, " LOGSTORE_DEFAULT_PATH " by default");
+                puts("-n <count>      Only print the last count messages");
+                puts("-s <time>       Only print messages from time on, in seconds since the");
+                puts("                epoch, or seconds ago when starting with '-'");
+                puts("-F              Wait for new messages and print them");
+                return 0;
+            case 'v':
+                puts("logread" VERSION_STR);
+                return 0;
+            case 'o':
+                store_path = optarg;
+                break;
+            case 'n': {
+                char *end;
+                tail = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || tail < 0) {
+                    fprintf(stderr, "logread: '%s' is not a valid count\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 's': {
+                char *end;
+                has_since = true;
+                since = strtoll(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || since > INT64_MAX / 1000000000LL ||
+                    since < -INT64_MAX / 1000000000LL) {
+                    fprintf(stderr, "logread: '%s' is not a valid time\n", optarg);
+                    return 1;
+                }
+                if (since < 0) {
+                    since += time(NULL);
+                }
+                since *= 1000000000LL;
+                break;
+            }
+            case 'F':
+                follow = true;
+                break;
+            default:
+                fprintf(stderr, "logread: %c is not a valid argument\n", optopt);
+                return 1;
+        }
+    }
+
+    struct logstore store;
+    if (logstore_open(&store, store_path)) {
+        perror("logread: Could not open the log store");
+        return 1;
+    }
+
+    struct logstore_iter iter;
+    if (has_since) {
+        logstore_seek_time(&store, &iter, since);
+    } else if (tail >= 0) {
+        logstore_seek_tail(&store, &iter, tail);
+    } else {
+        logstore_seek_tail(&store, &iter, UINT32_MAX);
+    }
+
+    static uint64_t buffer[LOGSTORE_MAX_RECORD / sizeof(uint64_t)];
+    for (;;) {
+        while (logstore_next(&store, &iter, buffer)) {
+            if (iter.lost) {
+                fprintf(stderr, "logread: Messages were overwritten while reading\n");
+                iter.lost = false;
+            }
+            print_record((const struct logstore_record *)buffer);
+        }
+        if (!follow) {
+            break;
+        }
+
+        fflush(stdout);
+        struct timespec interval = {
+            .tv_sec  = FOLLOW_INTERVAL_MS / 1000,
+            .tv_nsec = (FOLLOW_INTERVAL_MS % 1000) * 1000000
+        };
+        nanosleep(&interval, NULL);
+    }
+
+    logstore_close(&store);
+    return 0;
+}
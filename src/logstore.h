@@ -0,0 +1,456 @@
+/*
+    logstore.h: Memory-mapped, segmented storage for syslog messages.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// The store is a single preallocated file, a header page followed by a ring
+// of fixed size segments. Segments are handed out generation numbers that
+// only grow, generation g living in segment g % segment_count, so rotating
+// is just resetting the oldest segment in place and nothing is ever copied.
+//
+// There is a single writer, readers map the file read-only and detect that
+// the segment they are reading got recycled under them by its generation
+// changing, as it is cleared before the segment is reset.
+#define LOGSTORE_MAGIC 0x3145524f5453474cULL
+#define LOGSTORE_DEFAULT_PATH "/var/log/syslog.store"
+#define LOGSTORE_DEFAULT_SEGMENT_SIZE (1024 * 1024)
+#define LOGSTORE_DEFAULT_SEGMENTS 8
+#define LOGSTORE_HEADER_SIZE 4096
+#define LOGSTORE_EMPTY UINT64_MAX
+#define LOGSTORE_INDEX_ENTRIES 64
+#define LOGSTORE_MAX_TAG 255
+#define LOGSTORE_MAX_MESSAGE 2048
+#define LOGSTORE_ALIGN(x) (((x) + 7) & ~(size_t)7)
+#define LOGSTORE_MAX_RECORD \
+    LOGSTORE_ALIGN(sizeof(struct logstore_record) + LOGSTORE_MAX_TAG + LOGSTORE_MAX_MESSAGE)
+
+struct logstore_header {
+    uint64_t magic;
+    uint32_t segment_size;
+    uint32_t segment_count;
+    _Atomic uint64_t current;
+};
+
+// Every segment keeps the time and position of the records that cross each
+// 1/LOGSTORE_INDEX_ENTRIES of its space, to seek without scanning it all.
+struct logstore_index {
+    int64_t time;
+    uint32_t offset;
+    uint32_t record;
+};
+
+struct logstore_segment {
+    _Atomic uint64_t generation;
+    _Atomic uint32_t used;
+    _Atomic uint32_t records;
+    _Atomic uint32_t index_count;
+    uint32_t unused;
+    int64_t first_time;
+    int64_t last_time;
+    struct logstore_index index[LOGSTORE_INDEX_ENTRIES];
+};
+
+// Records are followed by the tag and message, and padded to 8 bytes.
+// Times are in nanoseconds since the epoch.
+struct logstore_record {
+    int64_t time;
+    uint32_t length;
+    uint16_t message_len;
+    uint8_t priority;
+    uint8_t tag_len;
+};
+
+struct logstore {
+    char *map;
+    size_t map_size;
+    struct logstore_header *header;
+    size_t data_start;
+    size_t capacity;
+};
+
+static inline struct logstore_segment *logstore_segment(const struct logstore *store,
+                                                        uint64_t generation) {
+    uint64_t idx = generation % store->header->segment_count;
+    return (struct logstore_segment *)(store->map + LOGSTORE_HEADER_SIZE +
+                                       idx * store->header->segment_size);
+}
+
+static inline char *logstore_data(const struct logstore *store, uint64_t generation) {
+    return (char *)logstore_segment(store, generation) + store->data_start;
+}
+
+static inline uint64_t logstore_oldest(const struct logstore *store) {
+    uint64_t current = atomic_load_explicit(&store->header->current, memory_order_acquire);
+    uint64_t count = store->header->segment_count;
+    return current >= count - 1 ? current - (count - 1) : 0;
+}
+
+static inline void logstore_reset_segment(struct logstore *store, uint64_t generation) {
+    struct logstore_segment *seg = logstore_segment(store, generation);
+    atomic_store_explicit(&seg->generation, LOGSTORE_EMPTY, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    atomic_store_explicit(&seg->used, 0, memory_order_relaxed);
+    atomic_store_explicit(&seg->records, 0, memory_order_relaxed);
+    atomic_store_explicit(&seg->index_count, 0, memory_order_relaxed);
+    seg->first_time = 0;
+    seg->last_time = 0;
+    atomic_store_explicit(&seg->generation, generation, memory_order_release);
+}
+
+static inline void logstore_close(struct logstore *store) {
+    if (store->map != NULL) {
+        munmap(store->map, store->map_size);
+    }
+    memset(store, 0, sizeof(struct logstore));
+}
+
+static inline int logstore_map(struct logstore *store, int fd, size_t size,
+                               uint32_t segment_size, bool writable) {
+    store->map_size = size;
+    store->map = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_SHARED, fd, 0);
+    if (store->map == MAP_FAILED) {
+        store->map = NULL;
+        return -1;
+    }
+    store->header = (struct logstore_header *)store->map;
+    store->data_start = LOGSTORE_ALIGN(sizeof(struct logstore_segment));
+    store->capacity = segment_size - store->data_start;
+    return 0;
+}
+
+// Write the whole file out, so that its blocks are allocated now and a
+// full disk cannot fault the writes into the mapping later.
+static inline int logstore_preallocate(int fd, size_t size) {
+    static const char zeros[65536];
+    for (size_t done = 0; done < size;) {
+        size_t len = size - done < sizeof(zeros) ? size - done : sizeof(zeros);
+        ssize_t count = pwrite(fd, zeros, len, done);
+        if (count <= 0) {
+            return -1;
+        }
+        done += count;
+    }
+    return fsync(fd);
+}
+
+// Open a store for writing, keeping its contents, or creating it when the
+// file is empty. Files that are not stores, or stores of a different
+// geometry, are left alone and fail with EINVAL and EEXIST respectively.
+// Returns 0 on success.
+static inline int logstore_create(struct logstore *store, const char *path,
+                                  uint32_t segment_size, uint32_t segment_count) {
+    memset(store, 0, sizeof(struct logstore));
+    if (segment_count < 2 || segment_size < LOGSTORE_ALIGN(sizeof(struct logstore_segment)) +
+        LOGSTORE_MAX_RECORD) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0640);
+    if (fd == -1) {
+        return -1;
+    }
+
+    size_t size = LOGSTORE_HEADER_SIZE + (size_t)segment_size * segment_count;
+    struct logstore_header old = {0};
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return -1;
+    }
+
+    bool reuse = st.st_size != 0;
+    if (reuse) {
+        int error = 0;
+        if (pread(fd, &old, sizeof(old), 0) != sizeof(old) || old.magic != LOGSTORE_MAGIC) {
+            error = EINVAL;
+        } else if ((size_t)st.st_size != size || old.segment_size != segment_size ||
+                   old.segment_count != segment_count) {
+            error = EEXIST;
+        }
+        if (error != 0) {
+            close(fd);
+            errno = error;
+            return -1;
+        }
+    } else if (logstore_preallocate(fd, size)) {
+        int error = errno;
+        ftruncate(fd, 0);
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    if (logstore_map(store, fd, size, segment_size, true)) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    if (!reuse) {
+        store->header->segment_size = segment_size;
+        store->header->segment_count = segment_count;
+        atomic_store(&store->header->current, 0);
+        for (uint32_t i = 0; i < segment_count; i++) {
+            atomic_store(&logstore_segment(store, i)->generation, LOGSTORE_EMPTY);
+        }
+        logstore_reset_segment(store, 0);
+        store->header->magic = LOGSTORE_MAGIC;
+    }
+    return 0;
+}
+
+// Open an existing store for reading, returns 0 on success.
+static inline int logstore_open(struct logstore *store, const char *path) {
+    memset(store, 0, sizeof(struct logstore));
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct logstore_header header;
+    struct stat st;
+    if (fstat(fd, &st) || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        header.magic != LOGSTORE_MAGIC || header.segment_count < 2 ||
+        header.segment_size < LOGSTORE_ALIGN(sizeof(struct logstore_segment)) +
+                              LOGSTORE_MAX_RECORD ||
+        (size_t)st.st_size != LOGSTORE_HEADER_SIZE +
+                              (size_t)header.segment_size * header.segment_count ||
+        logstore_map(store, fd, st.st_size, header.segment_size, false)) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+// Append a message, rotating to the next segment if it does not fit. Tags
+// and messages over the limits are truncated.
+static inline void logstore_append(struct logstore *store, int64_t time, int priority,
+                                   const char *tag, size_t tag_len,
+                                   const char *message, size_t message_len) {
+    if (tag_len > LOGSTORE_MAX_TAG) {
+        tag_len = LOGSTORE_MAX_TAG;
+    }
+    if (message_len > LOGSTORE_MAX_MESSAGE) {
+        message_len = LOGSTORE_MAX_MESSAGE;
+    }
+
+    uint32_t length = LOGSTORE_ALIGN(sizeof(struct logstore_record) + tag_len + message_len);
+    uint64_t generation = atomic_load_explicit(&store->header->current, memory_order_relaxed);
+    struct logstore_segment *seg = logstore_segment(store, generation);
+    uint32_t used = atomic_load_explicit(&seg->used, memory_order_relaxed);
+    if (used + length > store->capacity) {
+        generation++;
+        logstore_reset_segment(store, generation);
+        atomic_store_explicit(&store->header->current, generation, memory_order_release);
+        seg = logstore_segment(store, generation);
+        used = 0;
+    }
+
+    char *dest = logstore_data(store, generation) + used;
+    struct logstore_record *rec = (struct logstore_record *)dest;
+    rec->time = time;
+    rec->length = length;
+    rec->message_len = message_len;
+    rec->priority = priority;
+    rec->tag_len = tag_len;
+    memcpy(dest + sizeof(struct logstore_record), tag, tag_len);
+    memcpy(dest + sizeof(struct logstore_record) + tag_len, message, message_len);
+
+    uint32_t records = atomic_load_explicit(&seg->records, memory_order_relaxed);
+    uint32_t index_count = atomic_load_explicit(&seg->index_count, memory_order_relaxed);
+    if (index_count < LOGSTORE_INDEX_ENTRIES &&
+        used >= index_count * (store->capacity / LOGSTORE_INDEX_ENTRIES)) {
+        seg->index[index_count].time = time;
+        seg->index[index_count].offset = used;
+        seg->index[index_count].record = records;
+        atomic_store_explicit(&seg->index_count, index_count + 1, memory_order_release);
+    }
+    if (records == 0) {
+        seg->first_time = time;
+    }
+    seg->last_time = time;
+
+    atomic_store_explicit(&seg->records, records + 1, memory_order_release);
+    atomic_store_explicit(&seg->used, used + length, memory_order_release);
+}
+
+// Readers walk the store with an iterator, which starts at the oldest record.
+struct logstore_iter {
+    uint64_t generation;
+    uint32_t offset;
+    uint32_t record;
+    bool lost;
+};
+
+static inline void logstore_iter_at(struct logstore_iter *iter, uint64_t generation,
+                                    uint32_t offset, uint32_t record) {
+    iter->generation = generation;
+    iter->offset = offset;
+    iter->record = record;
+}
+
+// Find the last index entry of a segment at or before a time or record.
+static inline const struct logstore_index *logstore_index_before(
+    const struct logstore_segment *seg, bool by_time, int64_t time, uint32_t record) {
+    uint32_t count = atomic_load_explicit(&seg->index_count, memory_order_acquire);
+    uint32_t low = 0, high = count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        bool before = by_time ? seg->index[mid].time <= time : seg->index[mid].record <= record;
+        if (before) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low == 0 ? NULL : &seg->index[low - 1];
+}
+
+// Skip forward from an index entry to the first record at or after time,
+// or to a record number.
+static inline void logstore_scan(const struct logstore *store, struct logstore_iter *iter,
+                                 bool by_time, int64_t time, uint32_t record) {
+    const struct logstore_segment *seg = logstore_segment(store, iter->generation);
+    const char *data = logstore_data(store, iter->generation);
+    uint32_t used = atomic_load_explicit(&seg->used, memory_order_acquire);
+    while (iter->offset < used) {
+        const struct logstore_record *rec = (const struct logstore_record *)(data + iter->offset);
+        if (by_time ? rec->time >= time : iter->record >= record) {
+            return;
+        }
+        if (rec->length < sizeof(struct logstore_record) || rec->length > used - iter->offset) {
+            return;
+        }
+        iter->offset += rec->length;
+        iter->record++;
+    }
+}
+
+// Position an iterator at the first record at or after time.
+static inline void logstore_seek_time(const struct logstore *store, struct logstore_iter *iter,
+                                      int64_t time) {
+    uint64_t current = atomic_load_explicit(&store->header->current, memory_order_acquire);
+    iter->lost = false;
+    for (uint64_t gen = logstore_oldest(store); gen <= current; gen++) {
+        const struct logstore_segment *seg = logstore_segment(store, gen);
+        if (atomic_load_explicit(&seg->generation, memory_order_acquire) != gen ||
+            atomic_load_explicit(&seg->records, memory_order_acquire) == 0 ||
+            (seg->last_time < time && gen != current)) {
+            continue;
+        }
+
+        const struct logstore_index *entry = logstore_index_before(seg, true, time, 0);
+        if (entry == NULL) {
+            logstore_iter_at(iter, gen, 0, 0);
+        } else {
+            logstore_iter_at(iter, gen, entry->offset, entry->record);
+        }
+        logstore_scan(store, iter, true, time, 0);
+        return;
+    }
+    logstore_iter_at(iter, current, 0, 0);
+}
+
+// Position an iterator so that count records are left until the end.
+static inline void logstore_seek_tail(const struct logstore *store, struct logstore_iter *iter,
+                                      uint32_t count) {
+    uint64_t oldest = logstore_oldest(store);
+    uint64_t gen = atomic_load_explicit(&store->header->current, memory_order_acquire);
+    iter->lost = false;
+    for (;; gen--) {
+        const struct logstore_segment *seg = logstore_segment(store, gen);
+        uint32_t records = 0;
+        if (atomic_load_explicit(&seg->generation, memory_order_acquire) == gen) {
+            records = atomic_load_explicit(&seg->records, memory_order_acquire);
+        }
+        if (records >= count || gen == oldest) {
+            uint32_t skip = records > count ? records - count : 0;
+            const struct logstore_index *entry = logstore_index_before(seg, false, 0, skip);
+            if (entry == NULL) {
+                logstore_iter_at(iter, gen, 0, 0);
+            } else {
+                logstore_iter_at(iter, gen, entry->offset, entry->record);
+            }
+            logstore_scan(store, iter, false, 0, skip);
+            return;
+        }
+        count -= records;
+    }
+}
+
+// Copy the next record into buffer, which must be LOGSTORE_MAX_RECORD bytes,
+// returns false when there are no more records for now. If the writer laps
+// the iterator, it continues at the oldest record and sets lost.
+static inline bool logstore_next(const struct logstore *store, struct logstore_iter *iter,
+                                 void *buffer) {
+    for (;;) {
+        const struct logstore_segment *seg = logstore_segment(store, iter->generation);
+        uint64_t current = atomic_load_explicit(&store->header->current, memory_order_acquire);
+        if (atomic_load_explicit(&seg->generation, memory_order_acquire) != iter->generation) {
+            if (iter->generation > current) {
+                return false;
+            }
+            logstore_iter_at(iter, logstore_oldest(store), 0, 0);
+            iter->lost = true;
+            continue;
+        }
+
+        uint32_t used = atomic_load_explicit(&seg->used, memory_order_acquire);
+        if (iter->offset >= used) {
+            if (iter->generation >= current) {
+                return false;
+            }
+            logstore_iter_at(iter, iter->generation + 1, 0, 0);
+            continue;
+        }
+
+        const char *src = logstore_data(store, iter->generation) + iter->offset;
+        uint32_t length = ((const struct logstore_record *)src)->length;
+        bool valid = length >= sizeof(struct logstore_record) &&
+                     length <= LOGSTORE_MAX_RECORD && length <= used - iter->offset;
+        if (valid) {
+            memcpy(buffer, src, length);
+        }
+
+        // The copy is only good if the segment was not recycled meanwhile.
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&seg->generation, memory_order_relaxed) != iter->generation) {
+            continue;
+        }
+        if (!valid) {
+            logstore_iter_at(iter, iter->generation + 1, 0, 0);
+            continue;
+        }
+        iter->offset += length;
+        iter->record++;
+        return true;
+    }
+}
@@ -0,0 +1,281 @@
+/*
+    lowmemd.c: Act on processes when memory runs low.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+#include <syslog.h>
+#include <sys/wait.h>
+#include <commons.h>
+#include <sysinfo.h>
+
+// Sampling gets faster as free memory gets closer to the watermark, going
+// from MAX_INTERVAL_MS with all memory free down to MIN_INTERVAL_MS at it.
+#define MIN_INTERVAL_MS 100
+#define MAX_INTERVAL_MS 5000
+#define DEFAULT_WATERMARK 5.0
+#define DEFAULT_HYSTERESIS 5.0
+#define DEFAULT_COOLDOWN_MS 10000
+#define MAX_VICTIMS 32
+
+// Processes to act on, by name and in the order they were given, which is
+// their priority. The kernel does not report the memory used by a process,
+// so there is no picking the largest one.
+struct victim {
+    const char *name;
+    int signal;
+    bool signalled; // Already acted on since the last time we were armed.
+};
+
+static struct victim victims[MAX_VICTIMS];
+static int victim_count = 0;
+static struct sysinfo_list procs = {0};
+
+static int parse_victim(char *arg) {
+    if (victim_count == MAX_VICTIMS) {
+        fprintf(stderr, "lowmemd: Too many processes, at most %d\n", MAX_VICTIMS);
+        return -1;
+    }
+
+    int sig = SIGTERM;
+    char *colon = strchr(arg, ':');
+    if (colon != NULL) {
+        *colon = '\0';
+        if (!strcmp(colon + 1, "TERM")) {
+            sig = SIGTERM;
+        } else if (!strcmp(colon + 1, "KILL")) {
+            sig = SIGKILL;
+        } else if (!strcmp(colon + 1, "INT")) {
+            sig = SIGINT;
+        } else if (!strcmp(colon + 1, "HUP")) {
+            sig = SIGHUP;
+        } else if (!strcmp(colon + 1, "USR1")) {
+            sig = SIGUSR1;
+        } else if (!strcmp(colon + 1, "USR2")) {
+            sig = SIGUSR2;
+        } else {
+            fprintf(stderr, "lowmemd: Unknown signal '%s'\n", colon + 1);
+            return -1;
+        }
+    }
+
+    victims[victim_count].name = arg;
+    victims[victim_count].signal = sig;
+    victims[victim_count].signalled = false;
+    victim_count++;
+    return 0;
+}
+
+// Signal every running process of the first victim in the list that has any
+// and was not acted on yet, so that a process that ignores the signal does not
+// keep the next ones from being acted on. Returns whether one was found.
+static bool signal_next_victim(void) {
+    if (sysinfo_fetch(&procs, SYSCALL_LISTPROCS, sizeof(struct procinfo))) {
+        syslog(LOG_ERR, "Could not list processes");
+        return false;
+    }
+
+    const struct procinfo *list = procs.items;
+    for (int v = 0; v < victim_count; v++) {
+        if (victims[v].signalled) {
+            continue;
+        }
+
+        bool found = false;
+        size_t name_len = strlen(victims[v].name);
+        for (size_t i = 0; i < procs.count; i++) {
+            if ((list[i].flags & PROC_EXITED) || list[i].id_len != name_len ||
+                memcmp(list[i].id, victims[v].name, name_len)) {
+                continue;
+            }
+            if (kill(list[i].pid, victims[v].signal)) {
+                syslog(LOG_ERR, "Could not signal %s (%d)", victims[v].name, list[i].pid);
+            } else {
+                syslog(LOG_WARNING, "Sent signal %d to %s (%d)", victims[v].signal,
+                       victims[v].name, list[i].pid);
+                found = true;
+            }
+        }
+        if (found) {
+            victims[v].signalled = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run_hook(const char *hook, double free_percent) {
+    char value[32];
+    snprintf(value, sizeof(value), "%.1f", free_percent);
+
+    pid_t child = fork();
+    if (child == 0) {
+        setenv("LOWMEMD_FREE_PERCENT", value, 1);
+        execl("/bin/sh", "sh", "-c", hook, NULL);
+        _exit(127);
+    } else if (child == -1) {
+        syslog(LOG_ERR, "Could not run hook");
+    }
+}
+
+// Parse a percentage in [0, 100), returns 0 on success.
+static int parse_percent(const char *arg, double *value) {
+    char *end;
+    *value = strtod(arg, &end);
+    return *arg == '\0' || *end != '\0' || !(*value >= 0 && *value < 100) ? -1 : 0;
+}
+
+static long next_interval(double free_percent, double watermark) {
+    if (free_percent <= watermark) {
+        return MIN_INTERVAL_MS;
+    }
+    double headroom = (free_percent - watermark) / (100.0 - watermark);
+    long interval = MIN_INTERVAL_MS + headroom * (MAX_INTERVAL_MS - MIN_INTERVAL_MS);
+    return interval > MAX_INTERVAL_MS ? MAX_INTERVAL_MS : interval;
+}
+
+int main(int argc, char *argv[]) {
+    double watermark = DEFAULT_WATERMARK;
+    double hysteresis = DEFAULT_HYSTERESIS;
+    long cooldown = DEFAULT_COOLDOWN_MS;
+    const char *hook = NULL;
+    bool foreground = false;
+
+    char c;
+    while ((c = getopt(argc, argv, "hvfw:r:c:k:x:")) != -1) {
+        switch (c) {
+            case 'h':
+                puts("Usage: lowmemd [options]");
+                puts("");
+                puts("Options:");
+                puts("-h              Print this help message");
+                puts("-v              Display version information.");
+                puts("-f              Stay in the foreground");
+                puts("-w <percent>    Act when free memory goes under this percent of");
+                puts("                the available memory, 5 by default");
+                puts("-r <percent>    Rearm once free memory is this much over the");
+                puts("                watermark again, 5 by default");
+                puts("-c <ms>         Wait between actions while still under the watermark");
+                puts("-k <name[:sig]> Signal the processes called name, TERM by default,");
+                puts("                can be repeated with the first ones acted on first");
+                puts("-x <command>    Run command with sh when crossing the watermark");
+                return 0;
+            case 'v':
+                puts("lowmemd" VERSION_STR);
+                return 0;
+            case 'f':
+                foreground = true;
+                break;
+            case 'w':
+                if (parse_percent(optarg, &watermark) || watermark == 0) {
+                    fprintf(stderr, "lowmemd: '%s' is not a valid watermark\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'r':
+                if (parse_percent(optarg, &hysteresis)) {
+                    fprintf(stderr, "lowmemd: '%s' is not a valid hysteresis\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c': {
+                char *end;
+                cooldown = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || cooldown < 0) {
+                    fprintf(stderr, "lowmemd: '%s' is not a valid cooldown\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'k':
+                if (parse_victim(optarg)) {
+                    return 1;
+                }
+                break;
+            case 'x':
+                hook = optarg;
+                break;
+            default:
+                fprintf(stderr, "lowmemd: %c is not a valid argument\n", optopt);
+                return 1;
+        }
+    }
+
+    // Free memory could otherwise never reach the point where we rearm.
+    if (watermark + hysteresis >= 100) {
+        fprintf(stderr, "lowmemd: The watermark and hysteresis add up to 100%% or more\n");
+        return 1;
+    }
+
+    if (!foreground && daemon(0, 0)) {
+        perror("lowmemd: Could not daemonize");
+        return 1;
+    }
+
+    openlog("lowmemd", LOG_NDELAY | LOG_PID, LOG_DAEMON);
+    signal(SIGCHLD, SIG_IGN);
+
+    bool armed = true;
+    long since_action = 0;
+    for (;;) {
+        struct mem_info info;
+        if (sysinfo_meminfo(&info) || info.phys_available == 0) {
+            syslog(LOG_ERR, "Could not fetch memory information");
+            return 1;
+        }
+
+        double free_percent = 100.0 * info.phys_free / info.phys_available;
+        if (free_percent <= watermark) {
+            // Crossing the watermark acts right away, staying under it acts
+            // again on the next process only once the cooldown passed.
+            if (armed || since_action >= cooldown) {
+                if (armed) {
+                    syslog(LOG_WARNING, "Free memory at %.1f%%, under the %.1f%% watermark",
+                           free_percent, watermark);
+                    if (hook != NULL) {
+                        run_hook(hook, free_percent);
+                    }
+                }
+                if (victim_count != 0 && !signal_next_victim()) {
+                    syslog(LOG_WARNING, "No configured process left to act on");
+                }
+                armed = false;
+                since_action = 0;
+            }
+        } else if (!armed && free_percent >= watermark + hysteresis) {
+            syslog(LOG_NOTICE, "Free memory back at %.1f%%", free_percent);
+            armed = true;
+            for (int v = 0; v < victim_count; v++) {
+                victims[v].signalled = false;
+            }
+        }
+
+        long interval = next_interval(free_percent, watermark);
+        since_action += interval;
+        struct timespec wait = {
+            .tv_sec  = interval / 1000,
+            .tv_nsec = (interval % 1000) * 1000000
+        };
+        nanosleep(&wait, NULL);
+    }
+}
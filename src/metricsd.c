@@ -0,0 +1,419 @@
+/*
+    metricsd.c: Serve system metrics as OpenMetrics text on a UNIX socket.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <commons.h>
+#include <sysstat.h>
+
+#define DEFAULT_SOCKET_PATH "/var/run/metricsd.sock"
+#define DEFAULT_MIN_AGE_MS 1000
+#define DEFAULT_SOCKET_MODE 0666
+
+static volatile sig_atomic_t should_exit = 0;
+
+static void signal_handler(int sig) {
+    (void)sig;
+    should_exit = 1;
+}
+
+// The raw data behind the metrics, kept between scrapes so the lists are
+// not allocated every time.
+struct snapshot {
+    struct mem_info meminfo;
+    struct cpuinfo cpu;
+    bool has_cpu;
+    struct sysinfo_list procs;
+    struct sysinfo_list threads;
+    struct sysinfo_list clusters;
+    struct sysinfo_list mounts;
+    struct sysinfo_list netinters;
+    struct sysinfo_list flocks;
+};
+
+struct payload {
+    char    *data;
+    size_t   len;
+    size_t   capacity;
+    uint64_t hash;
+    bool     valid;
+    int64_t  taken_ns;
+};
+
+static int take_snapshot(struct snapshot *snap) {
+    snap->has_cpu = !sysinfo_cpuinfo(&snap->cpu);
+    return sysstat_meminfo(&snap->meminfo) ||
+           sysstat_fetch(&snap->procs, SYSCALL_LISTPROCS, sizeof(struct procinfo)) ||
+           sysinfo_fetch(&snap->threads, SYSCALL_LISTTHREADS, sizeof(struct threadinfo)) ||
+           sysinfo_fetch(&snap->clusters, SYSCALL_LISTCLUSTERS, sizeof(struct tclusterinfo)) ||
+           sysstat_fetch(&snap->mounts, SYSCALL_LISTMOUNTS, sizeof(struct mountinfo)) ||
+           sysstat_fetch(&snap->netinters, SYSCALL_LISTNETINTER, sizeof(struct netinterface)) ||
+           sysinfo_fetch(&snap->flocks, SYSCALL_LISTFLOCKS, sizeof(struct flockinfo));
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Hash only what ends up in the metrics, processes for one have their
+// elapsed time changing all the time while we only report how many there
+// are, so that unchanged metrics are not rendered again.
+static uint64_t hash_snapshot(const struct snapshot *snap) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t counts[] = {
+        snap->procs.count, snap->threads.count, snap->clusters.count, snap->flocks.count
+    };
+    hash = hash_bytes(hash, &snap->meminfo, sizeof(snap->meminfo));
+    hash = hash_bytes(hash, counts, sizeof(counts));
+    hash = hash_bytes(hash, &snap->has_cpu, sizeof(snap->has_cpu));
+    if (snap->has_cpu) {
+        hash = hash_bytes(hash, &snap->cpu, sizeof(snap->cpu));
+    }
+    hash = hash_bytes(hash, snap->mounts.items, snap->mounts.count * sizeof(struct mountinfo));
+    hash = hash_bytes(hash, snap->netinters.items,
+                      snap->netinters.count * sizeof(struct netinterface));
+    const struct flockinfo *flocks = snap->flocks.items;
+    for (size_t i = 0; i < snap->flocks.count; i++) {
+        hash = hash_bytes(hash, &flocks[i].mode, sizeof(flocks[i].mode));
+    }
+    return hash;
+}
+
+static void emit(struct payload *out, const char *fmt, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, fmt);
+        size_t room = out->capacity - out->len;
+        int written = vsnprintf(out->data + out->len, room, fmt, args);
+        va_end(args);
+        if (written < 0) {
+            return;
+        } else if ((size_t)written < room) {
+            out->len += written;
+            return;
+        }
+
+        size_t new_capacity = out->capacity * 2 > out->len + written + 1 ?
+                              out->capacity * 2 : out->len + written + 1;
+        char *grown = realloc(out->data, new_capacity);
+        if (grown == NULL) {
+            return;
+        }
+        out->data = grown;
+        out->capacity = new_capacity;
+    }
+}
+
+static void emit_family(struct payload *out, const char *name, const char *unit,
+                        const char *help) {
+    emit(out, "# TYPE %s gauge\n", name);
+    if (unit != NULL) {
+        emit(out, "# UNIT %s %s\n", name, unit);
+    }
+    emit(out, "# HELP %s %s\n", name, help);
+}
+
+// Label values are escaped as OpenMetrics asks, they come from names the
+// kernel was given and could hold anything.
+static void emit_label(struct payload *out, const char *name, const char *value,
+                       size_t len) {
+    emit(out, "%s=\"", name);
+    for (size_t i = 0; i < len && value[i] != '\0'; i++) {
+        switch (value[i]) {
+            case '\\': emit(out, "\\\\"); break;
+            case '"':  emit(out, "\\\""); break;
+            case '\n': emit(out, "\\n");  break;
+            default:   emit(out, "%c", value[i]); break;
+        }
+    }
+    emit(out, "\"");
+}
+
+static void emit_mount(struct payload *out, const char *name, const struct mountinfo *mnt,
+                       uint64_t value) {
+    const char *type = sysinfo_mount_type(mnt->type);
+    emit(out, "%s{", name);
+    emit_label(out, "mountpoint", mnt->location,
+               mnt->location_length < sizeof(mnt->location) ? mnt->location_length :
+                                                              sizeof(mnt->location));
+    emit(out, ",");
+    emit_label(out, "source", mnt->source,
+               mnt->source_length < sizeof(mnt->source) ? mnt->source_length :
+                                                          sizeof(mnt->source));
+    emit(out, ",");
+    emit_label(out, "type", type != NULL ? type : "unknown", SIZE_MAX);
+    emit(out, "} %" PRIu64 "\n", value);
+}
+
+static void render(struct payload *out, const struct snapshot *snap) {
+    out->len = 0;
+
+    const struct mem_info *mem = &snap->meminfo;
+    emit_family(out, "ironclad_memory_bytes", "bytes", "Memory of the system by use.");
+    emit(out, "ironclad_memory_bytes{kind=\"total\"} %" PRIu64 "\n", mem->phys_total);
+    emit(out, "ironclad_memory_bytes{kind=\"available\"} %" PRIu64 "\n", mem->phys_available);
+    emit(out, "ironclad_memory_bytes{kind=\"free\"} %" PRIu64 "\n", mem->phys_free);
+    emit(out, "ironclad_memory_bytes{kind=\"shared\"} %" PRIu64 "\n", mem->shared_usage);
+    emit(out, "ironclad_memory_bytes{kind=\"kernel\"} %" PRIu64 "\n", mem->kernel_usage);
+    emit(out, "ironclad_memory_bytes{kind=\"table\"} %" PRIu64 "\n", mem->table_usage);
+    emit(out, "ironclad_memory_bytes{kind=\"poison\"} %" PRIu64 "\n", mem->poison_usage);
+
+    emit_family(out, "ironclad_processes", NULL, "Processes in the system.");
+    emit(out, "ironclad_processes %zu\n", snap->procs.count);
+    emit_family(out, "ironclad_threads", NULL, "Threads in the system.");
+    emit(out, "ironclad_threads %zu\n", snap->threads.count);
+    emit_family(out, "ironclad_thread_clusters", NULL, "Thread clusters in the system.");
+    emit(out, "ironclad_thread_clusters %zu\n", snap->clusters.count);
+
+    const struct mountinfo *mounts = snap->mounts.items;
+    emit_family(out, "ironclad_mount_size_bytes", "bytes", "Size of mounted filesystems.");
+    for (size_t i = 0; i < snap->mounts.count; i++) {
+        emit_mount(out, "ironclad_mount_size_bytes", &mounts[i],
+                   mounts[i].sizeinfrags * mounts[i].fragsize);
+    }
+    emit_family(out, "ironclad_mount_free_bytes", "bytes",
+                "Free space of mounted filesystems.");
+    for (size_t i = 0; i < snap->mounts.count; i++) {
+        emit_mount(out, "ironclad_mount_free_bytes", &mounts[i],
+                   mounts[i].freeblocks * mounts[i].blocksize);
+    }
+    emit_family(out, "ironclad_mount_avail_bytes", "bytes",
+                "Free space of mounted filesystems usable by unprivileged users.");
+    for (size_t i = 0; i < snap->mounts.count; i++) {
+        emit_mount(out, "ironclad_mount_avail_bytes", &mounts[i],
+                   mounts[i].freeblocksu * mounts[i].blocksize);
+    }
+    emit_family(out, "ironclad_mount_inodes", NULL, "Inodes of mounted filesystems.");
+    for (size_t i = 0; i < snap->mounts.count; i++) {
+        emit_mount(out, "ironclad_mount_inodes", &mounts[i], mounts[i].inodecount);
+    }
+    emit_family(out, "ironclad_mount_inodes_free", NULL,
+                "Free inodes of mounted filesystems.");
+    for (size_t i = 0; i < snap->mounts.count; i++) {
+        emit_mount(out, "ironclad_mount_inodes_free", &mounts[i], mounts[i].freeinodes);
+    }
+
+    const struct netinterface *inters = snap->netinters.items;
+    emit_family(out, "ironclad_network_interface_up", NULL,
+                "Whether the network interface is not blocked.");
+    for (size_t i = 0; i < snap->netinters.count; i++) {
+        const uint8_t *mac = inters[i].mac_addr;
+        const uint8_t *ip = inters[i].ipv4_addr;
+        emit(out, "ironclad_network_interface_up{");
+        emit_label(out, "device", inters[i].devname, sizeof(inters[i].devname));
+        emit(out, ",address=\"%02x:%02x:%02x:%02x:%02x:%02x\",ipv4=\"%d.%d.%d.%d\"} %d\n",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], ip[0], ip[1], ip[2], ip[3],
+             !(inters[i].flags & NETINTER_BLOCKED));
+    }
+
+    const struct flockinfo *flocks = snap->flocks.items;
+    size_t writers = 0;
+    for (size_t i = 0; i < snap->flocks.count; i++) {
+        if (flocks[i].mode == FLOCK_MODE_WRITE) {
+            writers++;
+        }
+    }
+    emit_family(out, "ironclad_file_locks", NULL, "POSIX file locks held, by mode.");
+    emit(out, "ironclad_file_locks{mode=\"read\"} %zu\n", snap->flocks.count - writers);
+    emit(out, "ironclad_file_locks{mode=\"write\"} %zu\n", writers);
+
+    if (snap->has_cpu) {
+        const struct cpuinfo *cpu = &snap->cpu;
+        emit_family(out, "ironclad_cpu_frequency_hertz", "hertz", "Frequencies of the CPU.");
+        emit(out, "ironclad_cpu_frequency_hertz{kind=\"base\"} %" PRIu64 "\n",
+             (uint64_t)cpu->base_mhz * 1000000);
+        emit(out, "ironclad_cpu_frequency_hertz{kind=\"max\"} %" PRIu64 "\n",
+             (uint64_t)cpu->max_mhz * 1000000);
+        emit(out, "ironclad_cpu_frequency_hertz{kind=\"reference\"} %" PRIu64 "\n",
+             (uint64_t)cpu->ref_mhz * 1000000);
+        emit_family(out, "ironclad_cpu_cores", NULL, "Cores of the CPU.");
+        emit(out, "ironclad_cpu_cores{state=\"configured\"} %" PRIu64 "\n", cpu->conf_cores);
+        emit(out, "ironclad_cpu_cores{state=\"online\"} %" PRIu64 "\n", cpu->onln_cores);
+    }
+
+    emit(out, "# EOF\n");
+}
+
+// Scrapes closer than min_age to the last snapshot get the same payload
+// without asking anything, and snapshots that hash the same as the last
+// one get it without rendering.
+static bool refresh(struct payload *payload, struct snapshot *snap, long min_age) {
+    int64_t now = sysstat_now_ns();
+    if (payload->valid && now - payload->taken_ns < min_age * 1000000LL) {
+        return true;
+    }
+    if (take_snapshot(snap)) {
+        return payload->valid;
+    }
+
+    payload->taken_ns = now;
+    uint64_t hash = hash_snapshot(snap);
+    if (!payload->valid || hash != payload->hash) {
+        render(payload, snap);
+        payload->hash = hash;
+        payload->valid = true;
+    }
+    return true;
+}
+
+static void send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t count = write(fd, data, len);
+        if (count == -1 && errno == EINTR && !should_exit) {
+            continue;
+        } else if (count <= 0) {
+            return;
+        }
+        data += count;
+        len -= count;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *socket_path = DEFAULT_SOCKET_PATH;
+    long min_age = DEFAULT_MIN_AGE_MS;
+    mode_t socket_mode = DEFAULT_SOCKET_MODE;
+    bool foreground = false;
+
+    char c;
+    while ((c = getopt(argc, argv, "hvfS:M:m:")) != -1) {
+        switch (c) {
+            case 'h':
+                puts("Usage: metricsd [options]");
+                puts("");
+                puts("Options:");
+                puts("-h              Print this help message");
+                puts("-v              Display version information.");
+                puts("-f              Stay in the foreground");
+                puts("-S <path>       Listen on socket path, " DEFAULT_SOCKET_PATH " by default");
+                puts("-M <mode>       Octal mode of the socket, 0666 by default so that");
+                puts("                scrapers need not run as root");
+                puts("-m <ms>         Serve the same metrics to scrapes closer than ms to");
+                puts("                the last one, 1000 by default");
+                return 0;
+            case 'v':
+                puts("metricsd" VERSION_STR);
+                return 0;
+            case 'f':
+                foreground = true;
+                break;
+            case 'S':
+                socket_path = optarg;
+                break;
+            case 'M': {
+                char *end;
+                long mode = strtol(optarg, &end, 8);
+                if (*optarg == '\0' || *end != '\0' || mode < 0 || mode > 0777) {
+                    fprintf(stderr, "metricsd: '%s' is not a valid mode\n", optarg);
+                    return 1;
+                }
+                socket_mode = mode;
+                break;
+            }
+            case 'm': {
+                char *end;
+                min_age = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || min_age < 0 ||
+                    min_age > INT64_MAX / 1000000) {
+                    fprintf(stderr, "metricsd: '%s' is not a valid age\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            default:
+                fprintf(stderr, "metricsd: %c is not a valid argument\n", optopt);
+                return 1;
+        }
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "metricsd: Socket path is too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == -1) {
+        perror("metricsd: Could not create socket");
+        return 1;
+    }
+    unlink(socket_path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) || listen(sock, 8)) {
+        perror("metricsd: Could not listen on socket");
+        return 1;
+    }
+    if (chmod(socket_path, socket_mode)) {
+        perror("metricsd: Could not set the socket mode");
+        return 1;
+    }
+
+    if (!foreground && daemon(0, 0)) {
+        perror("metricsd: Could not daemonize");
+        return 1;
+    }
+
+    openlog("metricsd", LOG_NDELAY | LOG_PID, LOG_DAEMON);
+
+    // No SA_RESTART, so that accept is interrupted and we can clean up.
+    struct sigaction action = {0};
+    action.sa_handler = signal_handler;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Clients get the payload as soon as they connect, there is nothing to
+    // ask for, and it ends when we close the connection.
+    static struct snapshot snap;
+    static struct payload payload;
+    while (!should_exit) {
+        int client = accept(sock, NULL, NULL);
+        if (client == -1) {
+            continue;
+        }
+
+        if (refresh(&payload, &snap, min_age)) {
+            send_all(client, payload.data, payload.len);
+        } else {
+            syslog(LOG_ERR, "Could not take a snapshot of the system");
+        }
+        close(client);
+    }
+
+    close(sock);
+    unlink(socket_path);
+    return 0;
+}
@@ -29,24 +29,7 @@
 #include <dirent.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
-
-struct mountinfo {
-    uint32_t type;
-    uint32_t flags;
-    char     source[20];
-    uint32_t source_length;
-    char     location[20];
-    uint32_t location_length;
-    uint64_t blocksize;
-    uint64_t fragsize;
-    uint64_t sizeinfrags;
-    uint64_t freeblocks;
-    uint64_t freeblocksu;
-    uint64_t inodecount;
-    uint64_t freeinodes;
-    uint64_t freebinodesu;
-    uint64_t maxfile;
-};
+#include <sysinfo.h>
 
 #define DEV_UUID 0x9821
 
@@ -71,32 +54,22 @@ static int string_to_type(const char *type) {
    }
 }
 
-static char *type_to_string(int type) {
-   switch (type) {
-      case MNT_EXT: return "ext";
-      case MNT_FAT: return "fat";
-      case MNT_DEV: return "devfs";
-      default: return NULL;
-   }
-}
-
 static int update_mtab(void) {
-    long ret, errno;
-    struct mountinfo *buffer = malloc(5 * sizeof(struct mountinfo));
-    SYSCALL2(SYSCALL_LISTMOUNTS, buffer, 5);
-    if (ret == -1 || ret > 5) {
+    struct sysinfo_list mounts = {0};
+    if (sysinfo_fetch(&mounts, SYSCALL_LISTMOUNTS, sizeof(struct mountinfo))) {
         return 1;
     }
 
+    struct mountinfo *buffer = mounts.items;
     FILE *mtab = fopen("/etc/mtab", "w+");
     if (mtab == NULL) {
         perror("mount: could not open mtab");
         return 1;
     }
-    for (int i = 0; i < ret; i++) {
+    for (size_t i = 0; i < mounts.count; i++) {
         fprintf(mtab, "/dev/%.*s ", buffer[i].source_length, buffer[i].source);
         fprintf(mtab, "%.*s ", buffer[i].location_length, buffer[i].location);
-        fprintf(mtab, "%s ", type_to_string(buffer[i].type));
+        fprintf(mtab, "%s ", sysinfo_mount_type(buffer[i].type));
         if (buffer[i].flags & MS_RDONLY) {
             fprintf(mtab, "ro");
         } else {
@@ -114,27 +87,11 @@ static int update_mtab(void) {
 }
 
 static int print_kernel_mounts(void) {
-    long ret, errno;
-    struct mountinfo *buffer = malloc(5 * sizeof(struct mountinfo));
-    SYSCALL2(SYSCALL_LISTMOUNTS, buffer, 5);
-    if (ret == -1 || ret > 5) {
+    struct sysinfo_list mounts = {0};
+    if (sysinfo_fetch(&mounts, SYSCALL_LISTMOUNTS, sizeof(struct mountinfo))) {
         return 1;
     }
-
-    for (int i = 0; i < ret; i++) {
-        printf("%.*s ", buffer[i].source_length, buffer[i].source);
-        printf("%.*s ", buffer[i].location_length, buffer[i].location);
-        printf("type %s (", type_to_string(buffer[i].type));
-        if (buffer[i].flags & MS_RDONLY) {
-            printf("ro");
-        } else {
-            printf("rw");
-        }
-        if (buffer[i].flags & MS_RELATIME) {
-            printf(",relatime");
-        }
-        printf(")\n");
-    }
+    sysinfo_print_mounts(stdout, &mounts);
     return 0;
 }
 
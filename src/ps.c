@@ -26,57 +26,12 @@
 #include <inttypes.h>
 #include <string.h>
 #include <time.h>
+#include <sysstat.h>
 
-#define PROC_IS_TRACED  0b01
-#define PROC_EXITED     0b10
 #define SCHED_RR   0b001
 #define SCHED_COOP 0b010
 #define SCHED_INTR 0b100
 
-struct procinfo {
-    char     id[20];
-    uint16_t id_len;
-    uint16_t ppid;
-    uint16_t pid;
-    uint32_t uid;
-    uint32_t flags;
-    struct timespec elapsed;
-} __attribute__((packed));
-
-
-struct threadinfo {
-    uint16_t tid;
-    int16_t  niceness;
-    uint16_t tcid;
-    uint16_t pid;
-} __attribute__((packed));
-
-struct tclusterinfo {
-    uint16_t tcid;
-    uint16_t tcflags;
-    uint16_t tcquantum;
-} __attribute__((packed));
-
-static void print_process_list_header(void) {
-    printf("%4s %4s %11s %20s\n", "PPID", "PID", "STAT", "CMD");
-}
-
-static void print_process_list_process(struct procinfo *proc) {
-    char flags_message[] = "xxx-xxx";
-    if (proc->flags & PROC_IS_TRACED) {
-        flags_message[0] = 't';
-        flags_message[1] = 'r';
-        flags_message[2] = 'a';
-    }
-    if (proc->flags & PROC_EXITED) {
-        flags_message[4] = 'e';
-        flags_message[5] = 'x';
-        flags_message[6] = 'd';
-    }
-    printf("%4d %4d %11s %20.*s\n", proc->ppid, proc->pid, flags_message,
-        proc->id_len, proc->id);
-}
-
 int main(int argc, char *argv[]) {
     int print_all_users = 0;
     int print_threads   = 0;
@@ -131,15 +86,14 @@ int main(int argc, char *argv[]) {
     }
 
     if (print_threads) {
-        struct threadinfo *buffer = malloc(50 * sizeof(struct threadinfo));
-
-        long ret, errno;
-        SYSCALL2(SYSCALL_LISTTHREADS, buffer, 50);
-        if (ret == -1 || ret > 50) {
+        struct sysinfo_list list = {0};
+        if (sysinfo_fetch(&list, SYSCALL_LISTTHREADS, sizeof(struct threadinfo))) {
             return 1;
         }
 
-        const long count = ret;
+        struct threadinfo *buffer = list.items;
+        const long count = list.count;
+        long ret, errno;
         printf("%4s %4s %4s %4s %20s\n", "TID", "NICE", "TCID", "PID", "ID");
         for (int i = 0; i < count; i++) {
             char id_buf[64];
@@ -152,16 +106,14 @@ int main(int argc, char *argv[]) {
             printf("%4d %20.*s\n", buffer[i].pid, (int)strlen(id_buf), id_buf);
         }
     } else if (print_clusters) {
-        struct tclusterinfo *buffer = malloc(50 * sizeof(struct tclusterinfo));
-
-        long ret, errno;
-        SYSCALL2(SYSCALL_LISTCLUSTERS, buffer, 50);
-        if (ret == -1 || ret > 50) {
+        struct sysinfo_list list = {0};
+        if (sysinfo_fetch(&list, SYSCALL_LISTCLUSTERS, sizeof(struct tclusterinfo))) {
             return 1;
         }
 
+        struct tclusterinfo *buffer = list.items;
         printf("%4s %7s %4s\n", "TCID", "ALGO(I)", "QTUM");
-        for (int i = 0; i < ret; i++) {
+        for (size_t i = 0; i < list.count; i++) {
             printf("%4d ", buffer[i].tcid);
             if (buffer[i].tcflags & SCHED_RR) {
                 printf("  RR");
@@ -176,14 +128,14 @@ int main(int argc, char *argv[]) {
             printf(" %4d\n", buffer[i].tcquantum);
         }
     } else {
-        struct procinfo *buffer = malloc(50 * sizeof(struct procinfo));
-
-        long ret, errno;
-        SYSCALL2(SYSCALL_LISTPROCS, buffer, 50);
-        if (ret == -1 || ret > 50) {
+        struct sysinfo_list list = {0};
+        if (sysstat_fetch(&list, SYSCALL_LISTPROCS, sizeof(struct procinfo))) {
             return 1;
         }
 
+        struct procinfo *buffer = list.items;
+        const long ret = list.count;
+
         if (print_only_this) {
             for (int i = 0; i < ret; i++) {
                 if (buffer[i].pid == print_only_this) {
@@ -204,8 +156,8 @@ int main(int argc, char *argv[]) {
 
                         printf("%02ld:%02ld:%02ld\n", hours, minutes, seconds);
                     } else {
-                        print_process_list_header();
-                        print_process_list_process(&buffer[i]);
+                        sysinfo_print_process_header(stdout);
+                        sysinfo_print_process(stdout, &buffer[i]);
                     }
                     break;
                 }
@@ -213,11 +165,11 @@ int main(int argc, char *argv[]) {
         } else {
             uid_t current_uid = getuid();
 
-            print_process_list_header();
+            sysinfo_print_process_header(stdout);
             for (int i = 0; i < ret; i++) {
                 if ((print_all_users || buffer[i].uid == current_uid) &&
                     (!print_running || (buffer[i].flags & PROC_EXITED) == 0)) {
-                    print_process_list_process(&buffer[i]);
+                    sysinfo_print_process(stdout, &buffer[i]);
                 }
             }
         }
@@ -0,0 +1,183 @@
+/*
+    sadc.c: Record system activity samples for sar.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+#include <syslog.h>
+#include <sys/stat.h>
+#include <commons.h>
+#include <sysstat.h>
+#include <sarfile.h>
+
+#define DEFAULT_INTERVAL 10
+
+static volatile sig_atomic_t should_exit = 0;
+
+static void signal_handler(int sig) {
+    (void)sig;
+    should_exit = 1;
+}
+
+static struct sysinfo_list procs = {0}, threads = {0}, mounts = {0}, flocks = {0};
+
+// Processes, mounts and memory come from sysstatd when it is running, the
+// rest is asked to the kernel directly.
+static int sample(struct sarfile *sf, int64_t values[SAR_FIELDS]) {
+    struct mem_info info;
+    if (sysstat_meminfo(&info) ||
+        sysstat_fetch(&procs, SYSCALL_LISTPROCS, sizeof(struct procinfo)) ||
+        sysinfo_fetch(&threads, SYSCALL_LISTTHREADS, sizeof(struct threadinfo)) ||
+        sysstat_fetch(&mounts, SYSCALL_LISTMOUNTS, sizeof(struct mountinfo)) ||
+        sysinfo_fetch(&flocks, SYSCALL_LISTFLOCKS, sizeof(struct flockinfo))) {
+        return -1;
+    }
+
+    memset(values, 0, SAR_FIELDS * sizeof(int64_t));
+    values[SAR_MEM_TOTAL]     = info.phys_total     >> 10;
+    values[SAR_MEM_AVAILABLE] = info.phys_available >> 10;
+    values[SAR_MEM_FREE]      = info.phys_free      >> 10;
+    values[SAR_MEM_SHARED]    = info.shared_usage   >> 10;
+    values[SAR_MEM_KERNEL]    = info.kernel_usage   >> 10;
+    values[SAR_MEM_TABLE]     = info.table_usage    >> 10;
+    values[SAR_MEM_POISON]    = info.poison_usage   >> 10;
+
+    const struct procinfo *proc_list = procs.items;
+    for (size_t i = 0; i < procs.count; i++) {
+        if (!(proc_list[i].flags & PROC_EXITED)) {
+            values[SAR_PROCS]++;
+        }
+    }
+    values[SAR_THREADS] = threads.count;
+    values[SAR_FLOCKS] = flocks.count;
+
+    const struct mountinfo *mount_list = mounts.items;
+    for (size_t i = 0; i < mounts.count; i++) {
+        int slot = sar_mount_slot(sf, mount_list[i].location,
+                                  mount_list[i].location_length, true);
+        if (slot != -1) {
+            values[SAR_MOUNT_FIELDS + 2 * slot] =
+                mount_list[i].freeblocks * mount_list[i].blocksize >> 10;
+            values[SAR_MOUNT_FIELDS + 2 * slot + 1] = mount_list[i].freeinodes;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    long interval = DEFAULT_INTERVAL;
+    const char *dir = SAR_DEFAULT_DIR;
+    bool foreground = false;
+
+    char c;
+    while ((c = getopt(argc, argv, "hvfi:o:")) != -1) {
+        switch (c) {
+            case 'h':
+                puts("Usage: sadc [options]");
+                puts("");
+                puts("Options:");
+                puts("-h              Print this help message");
+                puts("-v              Display version information.");
+                puts("-f              Stay in the foreground");
+                puts("-i <seconds>    Take a sample every seconds, 10 by default");
+                puts("-o <dir>        Store the daily files in dir, " SAR_DEFAULT_DIR " by default");
+                return 0;
+            case 'v':
+                puts("sadc" VERSION_STR);
+                return 0;
+            case 'f':
+                foreground = true;
+                break;
+            case 'i': {
+                char *end;
+                interval = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || interval <= 0 || interval > 86400) {
+                    fprintf(stderr, "sadc: '%s' is not a valid interval\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'o':
+                dir = optarg;
+                break;
+            default:
+                fprintf(stderr, "sadc: %c is not a valid argument\n", optopt);
+                return 1;
+        }
+    }
+
+    mkdir(dir, 0755);
+    if (access(dir, W_OK)) {
+        perror("sadc: Could not access the output directory");
+        return 1;
+    }
+
+    if (!foreground && daemon(0, 0)) {
+        perror("sadc: Could not daemonize");
+        return 1;
+    }
+
+    openlog("sadc", LOG_NDELAY | LOG_PID, LOG_DAEMON);
+
+    struct sigaction action = {0};
+    action.sa_handler = signal_handler;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+
+    struct sarfile sf = {.fd = -1};
+    time_t day = 0;
+    bool failing = false;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    while (!should_exit) {
+        time_t now = time(NULL);
+        time_t today = sar_day_start(now);
+        if (today != day) {
+            char path[256];
+            sar_close(&sf);
+            sar_path(path, sizeof(path), dir, today);
+            if (sar_open(&sf, path, true, today, interval)) {
+                syslog(LOG_ERR, "Could not open %s: %m", path);
+            } else {
+                day = today;
+            }
+        }
+
+        // Only log the first of a run of failures, and when they stop.
+        int64_t values[SAR_FIELDS];
+        bool ok = sf.fd != -1 && !sample(&sf, values) &&
+                  !sar_append(&sf, now - day, values);
+        if (!ok && !failing) {
+            syslog(LOG_ERR, "Could not record a sample: %m");
+        } else if (ok && failing) {
+            syslog(LOG_NOTICE, "Recording samples again");
+        }
+        failing = !ok;
+
+        deadline.tv_sec += interval;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+    }
+
+    sar_close(&sf);
+    return 0;
+}
@@ -0,0 +1,293 @@
+/*
+    sar.c: Query the system activity samples recorded by sadc.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <time.h>
+#include <commons.h>
+#include <sarfile.h>
+
+#define DEFAULT_WINDOW_MINUTES 60
+
+// Parse HH:MM or HH:MM:SS into seconds since the start of the day.
+static long parse_clock(const char *arg) {
+    int hours, minutes, seconds = 0;
+    char extra;
+    int matched = sscanf(arg, "%d:%d:%d%c", &hours, &minutes, &seconds, &extra);
+    if (matched < 2 || matched > 3 || hours < 0 || hours > 23 || minutes < 0 ||
+        minutes > 59 || seconds < 0 || seconds > 59) {
+        return -1;
+    }
+    return hours * 3600 + minutes * 60 + seconds;
+}
+
+static time_t parse_day(const char *arg) {
+    struct tm tm = {0};
+    char extra;
+    if (sscanf(arg, "%4d%2d%2d%c", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &extra) != 3) {
+        return -1;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+// Fields are the names in sar_field_names, or free:<mount> and
+// inodes:<mount>. Mounts get their slots in every file separately, so
+// this is done per file.
+static int field_index(struct sarfile *sf, const char *name) {
+    for (int i = 0; i < SAR_MOUNT_FIELDS; i++) {
+        if (!strcmp(name, sar_field_names[i])) {
+            return i;
+        }
+    }
+
+    int offset;
+    if (!strncmp(name, "free:", 5)) {
+        name += 5;
+        offset = 0;
+    } else if (!strncmp(name, "inodes:", 7)) {
+        name += 7;
+        offset = 1;
+    } else {
+        return -1;
+    }
+    int slot = sar_mount_slot(sf, name, strlen(name), false);
+    return slot == -1 ? -1 : SAR_MOUNT_FIELDS + 2 * slot + offset;
+}
+
+static void format_time(char *buf, size_t len, time_t t, const char *fmt) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(buf, len, fmt, &tm);
+}
+
+static int open_day(struct sarfile *sf, const char *dir, time_t day, bool quiet) {
+    char path[256];
+    sar_path(path, sizeof(path), dir, day);
+    if (sar_open(sf, path, false, day, 0)) {
+        if (!quiet) {
+            fprintf(stderr, "sar: Could not open %s: ", path);
+            perror(NULL);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static int print_table(struct sarfile *sf, long start, long end) {
+    printf("%-8s %12s %12s %12s %6s %7s %6s\n", "TIME", "FREE KiB", "USED KiB",
+           "KERNEL KiB", "PROCS", "THREADS", "FLOCKS");
+
+    long n = sar_find(sf, start);
+    if (n == -1) {
+        return 1;
+    }
+    for (; (uint32_t)n < sf->header.record_count; n++) {
+        uint32_t seconds;
+        int64_t values[SAR_FIELDS];
+        if (sar_read(sf, n, &seconds, values)) {
+            return 1;
+        } else if (seconds > end) {
+            break;
+        }
+
+        char stamp[16];
+        format_time(stamp, sizeof(stamp), sf->header.day_start + seconds, "%H:%M:%S");
+        printf("%-8s %12" PRId64 " %12" PRId64 " %12" PRId64 " %6" PRId64 " %7" PRId64
+               " %6" PRId64 "\n", stamp, values[SAR_MEM_FREE],
+               values[SAR_MEM_AVAILABLE] - values[SAR_MEM_FREE], values[SAR_MEM_KERNEL],
+               values[SAR_PROCS], values[SAR_THREADS], values[SAR_FLOCKS]);
+    }
+    return 0;
+}
+
+// Print the last sample taken at or before the passed time of the day.
+static int print_at(struct sarfile *sf, long at) {
+    long n = sar_find(sf, at + 1);
+    if (n == -1) {
+        return 1;
+    } else if (n == 0) {
+        fprintf(stderr, "sar: No samples before that time\n");
+        return 1;
+    }
+
+    uint32_t seconds;
+    int64_t values[SAR_FIELDS];
+    if (sar_read(sf, n - 1, &seconds, values)) {
+        return 1;
+    }
+
+    char stamp[32];
+    format_time(stamp, sizeof(stamp), sf->header.day_start + seconds, "%Y-%m-%d %H:%M:%S");
+    printf("Sample at %s\n", stamp);
+    for (int i = 0; i < SAR_MOUNT_FIELDS; i++) {
+        printf("%-20s %" PRId64 "\n", sar_field_names[i], values[i]);
+    }
+    for (uint32_t i = 0; i < sf->header.mount_count; i++) {
+        const struct sar_mount_slot *slot = &sf->header.mounts[i];
+        char name[32];
+        snprintf(name, sizeof(name), "free:%.*s", (int)slot->location_length, slot->location);
+        printf("%-20s %" PRId64 "\n", name, values[SAR_MOUNT_FIELDS + 2 * i]);
+        snprintf(name, sizeof(name), "inodes:%.*s", (int)slot->location_length,
+                 slot->location);
+        printf("%-20s %" PRId64 "\n", name, values[SAR_MOUNT_FIELDS + 2 * i + 1]);
+    }
+    return 0;
+}
+
+// Print the maximum of a field between two times, which can span several
+// daily files, seeking straight to the start of the window in each.
+static int print_max(const char *dir, const char *field, time_t start, time_t end) {
+    bool found = false, known = false;
+    int64_t max = 0;
+    time_t max_time = 0;
+    for (time_t day = sar_day_start(start); day <= end;
+         day = sar_day_start(day + 86400 + 3600)) {
+        struct sarfile sf;
+        if (open_day(&sf, dir, day, true)) {
+            continue;
+        }
+        int index = field_index(&sf, field);
+        if (index == -1) {
+            sar_close(&sf);
+            continue;
+        }
+        known = true;
+
+        long n = sar_find(&sf, start > day ? start - day : 0);
+        for (; n != -1 && (uint32_t)n < sf.header.record_count; n++) {
+            uint32_t seconds;
+            int64_t values[SAR_FIELDS];
+            if (sar_read(&sf, n, &seconds, values) || day + seconds > end) {
+                break;
+            }
+            if (!found || values[index] > max) {
+                found = true;
+                max = values[index];
+                max_time = day + seconds;
+            }
+        }
+        sar_close(&sf);
+    }
+
+    if (!known) {
+        fprintf(stderr, "sar: Unknown field '%s'\n", field);
+        return 1;
+    } else if (!found) {
+        fprintf(stderr, "sar: No samples in that window\n");
+        return 1;
+    }
+
+    char stamp[32];
+    format_time(stamp, sizeof(stamp), max_time, "%Y-%m-%d %H:%M:%S");
+    printf("max %s: %" PRId64 " at %s\n", field, max, stamp);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = SAR_DEFAULT_DIR;
+    time_t day = sar_day_start(time(NULL));
+    bool has_day = false;
+    long start = 0, end = 86400 * 2, at = -1;
+    const char *max_field = NULL;
+    long window = DEFAULT_WINDOW_MINUTES;
+
+    char c;
+    while ((c = getopt(argc, argv, "hvo:d:s:e:a:x:l:")) != -1) {
+        switch (c) {
+            case 'h':
+                puts("Usage: sar [options]");
+                puts("");
+                puts("Options:");
+                puts("-h              Print this help message");
+                puts("-v              Display version information.");
+                puts("-o <dir>        Read the daily files in dir, " SAR_DEFAULT_DIR " by default");
+                puts("-d <YYYYMMDD>   Read the samples of that day, today by default");
+                puts("-s <HH:MM[:SS]> Only print samples from that time on");
+                puts("-e <HH:MM[:SS]> Only print samples up to that time");
+                puts("-a <HH:MM[:SS]> Print every field of the sample at that time");
+                puts("-x <field>      Print the maximum of field over a window, the fields");
+                puts("                being the ones printed by -a");
+                puts("-l <minutes>    Length of the window for -x, ending at the -a time");
+                puts("                or now, 60 by default");
+                return 0;
+            case 'v':
+                puts("sar" VERSION_STR);
+                return 0;
+            case 'o':
+                dir = optarg;
+                break;
+            case 'd':
+                day = parse_day(optarg);
+                has_day = true;
+                if (day == -1) {
+                    fprintf(stderr, "sar: '%s' is not a valid day\n", optarg);
+                    return 1;
+                }
+                break;
+            case 's':
+            case 'e':
+            case 'a': {
+                long value = parse_clock(optarg);
+                if (value == -1) {
+                    fprintf(stderr, "sar: '%s' is not a valid time\n", optarg);
+                    return 1;
+                }
+                *(c == 's' ? &start : c == 'e' ? &end : &at) = value;
+                break;
+            }
+            case 'x':
+                max_field = optarg;
+                break;
+            case 'l': {
+                char *end;
+                window = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || window <= 0 ||
+                    window > LONG_MAX / 60) {
+                    fprintf(stderr, "sar: '%s' is not a valid window\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            default:
+                fprintf(stderr, "sar: %c is not a valid argument\n", optopt);
+                return 1;
+        }
+    }
+
+    if (max_field != NULL) {
+        time_t window_end = at != -1 || has_day ? day + (at != -1 ? at : 86399) : time(NULL);
+        return print_max(dir, max_field, window_end - window * 60, window_end);
+    }
+
+    struct sarfile sf;
+    if (open_day(&sf, dir, day, false)) {
+        return 1;
+    }
+    int ret = at != -1 ? print_at(&sf, at) : print_table(&sf, start, end);
+    sar_close(&sf);
+    return ret;
+}
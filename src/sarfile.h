@@ -0,0 +1,363 @@
+/*
+    sarfile.h: Daily files of system activity samples, shared by sadc and sar.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// Every day gets its own file, a header page, then a fixed area for the
+// keyframes, then the records. Records all have the same size, so record n
+// is found by multiplying, and only hold the deltas of their values to the
+// keyframe before them, which has the full values. A keyframe is written
+// every SAR_KEYFRAME_EVERY records or when a delta does not fit, and as
+// keyframes are sorted by both record and time, they double as the index
+// for finding a time without reading the records.
+//
+// There is a single writer, which appends the record and keyframe before
+// updating the counts in the header, so readers never see partial ones.
+#define SAR_MAGIC 0x31524153
+#define SAR_VERSION 1
+#define SAR_DEFAULT_DIR "/var/log/sa"
+#define SAR_HEADER_SIZE 4096
+#define SAR_MAX_KEYFRAMES 4096
+#define SAR_KEYFRAME_EVERY 64
+#define SAR_MAX_MOUNTS 8
+
+// Memory is in KiB, and every mount has its free KiB and inodes.
+enum sar_field {
+    SAR_MEM_TOTAL,
+    SAR_MEM_AVAILABLE,
+    SAR_MEM_FREE,
+    SAR_MEM_SHARED,
+    SAR_MEM_KERNEL,
+    SAR_MEM_TABLE,
+    SAR_MEM_POISON,
+    SAR_PROCS,
+    SAR_THREADS,
+    SAR_FLOCKS,
+    SAR_MOUNT_FIELDS,
+    SAR_FIELDS = SAR_MOUNT_FIELDS + 2 * SAR_MAX_MOUNTS
+};
+
+static const char *const sar_field_names[SAR_MOUNT_FIELDS] = {
+    "memtotal", "memavail", "memfree", "memshared", "memkernel", "memtable",
+    "mempoison", "procs", "threads", "flocks"
+};
+
+struct sar_mount_slot {
+    char     location[20];
+    uint32_t location_length;
+};
+
+struct sar_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t field_count;
+    int64_t  day_start;
+    uint32_t interval;
+    uint32_t keyframe_count;
+    uint32_t record_count;
+    uint32_t mount_count;
+    struct sar_mount_slot mounts[SAR_MAX_MOUNTS];
+};
+
+struct sar_keyframe {
+    uint32_t record;
+    uint32_t seconds;
+    int64_t  values[SAR_FIELDS];
+};
+
+// Seconds are counted from the start of the day of the file.
+struct sar_record {
+    uint32_t seconds;
+    int32_t  deltas[SAR_FIELDS];
+};
+
+struct sarfile {
+    int fd;
+    struct sar_header header;
+    struct sar_keyframe key;
+    uint32_t key_index;
+    uint32_t key_end;
+    bool key_valid;
+};
+
+static inline time_t sar_day_start(time_t t) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+static inline void sar_path(char *buf, size_t len, const char *dir, time_t day_start) {
+    struct tm tm;
+    char name[16];
+    localtime_r(&day_start, &tm);
+    strftime(name, sizeof(name), "%Y%m%d", &tm);
+    snprintf(buf, len, "%s/sa%s", dir, name);
+}
+
+static inline off_t sar_keyframe_offset(uint32_t k) {
+    return SAR_HEADER_SIZE + (off_t)k * sizeof(struct sar_keyframe);
+}
+
+static inline off_t sar_record_offset(uint32_t n) {
+    return sar_keyframe_offset(SAR_MAX_KEYFRAMES) + (off_t)n * sizeof(struct sar_record);
+}
+
+static inline int sar_pread(int fd, void *buf, size_t len, off_t offset) {
+    return pread(fd, buf, len, offset) == (ssize_t)len ? 0 : -1;
+}
+
+static inline int sar_pwrite(int fd, const void *buf, size_t len, off_t offset) {
+    return pwrite(fd, buf, len, offset) == (ssize_t)len ? 0 : -1;
+}
+
+static inline int sar_load_keyframe(struct sarfile *sf, uint32_t k) {
+    if (sf->key_valid && sf->key_index == k) {
+        return 0;
+    }
+    if (sar_pread(sf->fd, &sf->key, sizeof(sf->key), sar_keyframe_offset(k))) {
+        sf->key_valid = false;
+        return -1;
+    }
+    sf->key_index = k;
+    sf->key_end = UINT32_MAX;
+    sf->key_valid = true;
+    if (k + 1 < sf->header.keyframe_count) {
+        uint32_t next;
+        if (sar_pread(sf->fd, &next, sizeof(next), sar_keyframe_offset(k + 1))) {
+            sf->key_valid = false;
+            return -1;
+        }
+        sf->key_end = next;
+    }
+    return 0;
+}
+
+// Open the file at path, creating it for the day starting at day_start
+// when writable and it does not exist. Returns 0 on success.
+static inline int sar_open(struct sarfile *sf, const char *path, bool writable,
+                           int64_t day_start, uint32_t interval) {
+    memset(sf, 0, sizeof(struct sarfile));
+    sf->fd = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (sf->fd == -1) {
+        return -1;
+    }
+
+    ssize_t len = pread(sf->fd, &sf->header, sizeof(sf->header), 0);
+    if (len == 0 && writable) {
+        sf->header.magic = SAR_MAGIC;
+        sf->header.version = SAR_VERSION;
+        sf->header.field_count = SAR_FIELDS;
+        sf->header.day_start = day_start;
+        sf->header.interval = interval;
+        if (sar_pwrite(sf->fd, &sf->header, sizeof(sf->header), 0)) {
+            goto fail;
+        }
+    } else if (len != sizeof(sf->header) || sf->header.magic != SAR_MAGIC ||
+               sf->header.version != SAR_VERSION || sf->header.field_count != SAR_FIELDS) {
+        errno = EINVAL;
+        goto fail;
+    }
+
+    if (writable && sf->header.keyframe_count != 0 &&
+        sar_load_keyframe(sf, sf->header.keyframe_count - 1)) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    close(sf->fd);
+    sf->fd = -1;
+    return -1;
+}
+
+static inline void sar_close(struct sarfile *sf) {
+    if (sf->fd != -1) {
+        close(sf->fd);
+    }
+    sf->fd = -1;
+}
+
+// Pick up appends done since opening, for readers of the current day.
+static inline int sar_refresh(struct sarfile *sf) {
+    sf->key_valid = false;
+    return sar_pread(sf->fd, &sf->header, sizeof(sf->header), 0);
+}
+
+// Find the mount slot for a location, taking a free one if asked to.
+// Returns -1 if there is none.
+static inline int sar_mount_slot(struct sarfile *sf, const char *location, size_t len,
+                                 bool add) {
+    if (len > sizeof(sf->header.mounts[0].location)) {
+        len = sizeof(sf->header.mounts[0].location);
+    }
+    for (uint32_t i = 0; i < sf->header.mount_count; i++) {
+        const struct sar_mount_slot *slot = &sf->header.mounts[i];
+        if (slot->location_length == len && !memcmp(slot->location, location, len)) {
+            return i;
+        }
+    }
+    if (!add || sf->header.mount_count == SAR_MAX_MOUNTS) {
+        return -1;
+    }
+    struct sar_mount_slot *slot = &sf->header.mounts[sf->header.mount_count];
+    memcpy(slot->location, location, len);
+    slot->location_length = len;
+    return sf->header.mount_count++;
+}
+
+// Append a sample, the header is written back with it, so new mount slots
+// are persisted here too. Returns 0 on success.
+static inline int sar_append(struct sarfile *sf, uint32_t seconds,
+                             const int64_t values[SAR_FIELDS]) {
+    uint32_t n = sf->header.record_count;
+    bool keyframe = !sf->key_valid || n - sf->key.record >= SAR_KEYFRAME_EVERY;
+
+    struct sar_record rec;
+    rec.seconds = seconds;
+    for (int i = 0; i < SAR_FIELDS && !keyframe; i++) {
+        int64_t delta = values[i] - sf->key.values[i];
+        if (delta < INT32_MIN || delta > INT32_MAX) {
+            keyframe = true;
+        }
+        rec.deltas[i] = delta;
+    }
+
+    if (keyframe) {
+        if (sf->header.keyframe_count == SAR_MAX_KEYFRAMES) {
+            errno = ENOSPC;
+            return -1;
+        }
+        sf->key.record = n;
+        sf->key.seconds = seconds;
+        memcpy(sf->key.values, values, sizeof(sf->key.values));
+        memset(rec.deltas, 0, sizeof(rec.deltas));
+        if (sar_pwrite(sf->fd, &sf->key, sizeof(sf->key),
+                       sar_keyframe_offset(sf->header.keyframe_count))) {
+            sf->key_valid = false;
+            return -1;
+        }
+    }
+    if (sar_pwrite(sf->fd, &rec, sizeof(rec), sar_record_offset(n))) {
+        if (keyframe) {
+            sf->key_valid = false;
+        }
+        return -1;
+    }
+
+    if (keyframe) {
+        sf->key_index = sf->header.keyframe_count++;
+        sf->key_end = UINT32_MAX;
+        sf->key_valid = true;
+    }
+    sf->header.record_count++;
+    return sar_pwrite(sf->fd, &sf->header, sizeof(sf->header), 0);
+}
+
+// Read back record n, returns 0 on success.
+static inline int sar_read(struct sarfile *sf, uint32_t n, uint32_t *seconds,
+                           int64_t values[SAR_FIELDS]) {
+    if (n >= sf->header.record_count) {
+        errno = ERANGE;
+        return -1;
+    }
+
+    if (!sf->key_valid || n < sf->key.record || n >= sf->key_end) {
+        uint32_t lo = 0, hi = sf->header.keyframe_count;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            uint32_t record;
+            if (sar_pread(sf->fd, &record, sizeof(record), sar_keyframe_offset(mid))) {
+                return -1;
+            }
+            if (record <= n) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        if (sar_load_keyframe(sf, lo)) {
+            return -1;
+        }
+    }
+
+    struct sar_record rec;
+    if (sar_pread(sf->fd, &rec, sizeof(rec), sar_record_offset(n))) {
+        return -1;
+    }
+    *seconds = rec.seconds;
+    for (int i = 0; i < SAR_FIELDS; i++) {
+        values[i] = sf->key.values[i] + rec.deltas[i];
+    }
+    return 0;
+}
+
+// Find the first record at or after seconds, going through the keyframes
+// first. Returns the record count if there is none, or -1 on errors.
+static inline long sar_find(struct sarfile *sf, uint32_t seconds) {
+    uint32_t lo = 0, hi = sf->header.keyframe_count;
+    if (hi == 0) {
+        return 0;
+    }
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t head[2];
+        if (sar_pread(sf->fd, head, sizeof(head), sar_keyframe_offset(mid))) {
+            return -1;
+        }
+        if (head[1] <= seconds) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    if (sar_load_keyframe(sf, lo)) {
+        return -1;
+    }
+
+    uint32_t first = sf->key.record;
+    uint32_t last = sf->key_end < sf->header.record_count ? sf->key_end :
+                                                            sf->header.record_count;
+    while (first < last) {
+        uint32_t mid = first + (last - first) / 2;
+        uint32_t rec_seconds;
+        if (sar_pread(sf->fd, &rec_seconds, sizeof(rec_seconds), sar_record_offset(mid))) {
+            return -1;
+        }
+        if (rec_seconds < seconds) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+    return first;
+}
@@ -22,26 +22,146 @@
 #include <sys/syscall.h>
 #include <math.h>
 #include <commons.h>
+#include <sysstat.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
 
-struct mem_info {
-    // All data is in bytes.
-    uint64_t phys_total;     // Total physical memory of the system.
-    uint64_t phys_available; // Non-reserved memory managed by the system.
-    uint64_t phys_free;      // Free memory available to the system.
-    uint64_t shared_usage;   // Amount of shared memory in the system.
-    uint64_t kernel_usage;   // Amount of memory in use by the kernel.
-    uint64_t table_usage;    // Of the kernel, amount in use for page tables.
-    uint64_t poison_usage;   // Faulty memory.
+// Fields followed in sampling mode, with their running extremes.
+#define TRACKED_FIELDS 4
+static const char *field_names[TRACKED_FIELDS] = {"free", "kernel", "table", "shared"};
+
+// Binary samples are written as is, for other programs to consume.
+struct sample_record {
+    int64_t time_ns;
+    struct mem_info info;
 };
 
+static volatile sig_atomic_t should_stop = 0;
+
+static void signal_handler(int sig) {
+    (void)sig;
+    should_stop = 1;
+}
+
+static int64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void tracked_values(const struct mem_info *info, int64_t *values) {
+    values[0] = info->phys_free;
+    values[1] = info->kernel_usage;
+    values[2] = info->table_usage;
+    values[3] = info->shared_usage;
+}
+
+// Take count samples, or until interrupted when count is 0, at fixed
+// deadlines so that rates are not skewed by our own runtime.
+static int sample(double interval, long count, bool binary) {
+    struct sigaction action = {0};
+    action.sa_handler = signal_handler;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    int64_t interval_ns = interval * 1000000000.0;
+    int64_t deadline = monotonic_ns();
+    int64_t prev_time = 0;
+    int64_t prev[TRACKED_FIELDS], min[TRACKED_FIELDS], max[TRACKED_FIELDS];
+    if (!binary) {
+        // Every field gets its value, delta and rate, and its extremes so far.
+        printf("%8s", "time(s)");
+        for (int i = 0; i < TRACKED_FIELDS; i++) {
+            char name[5][16];
+            snprintf(name[0], sizeof(name[0]), "%s(kB)", field_names[i]);
+            snprintf(name[1], sizeof(name[1]), "d%s", field_names[i]);
+            snprintf(name[2], sizeof(name[2]), "%s/s", field_names[i]);
+            snprintf(name[3], sizeof(name[3]), "min%s", field_names[i]);
+            snprintf(name[4], sizeof(name[4]), "max%s", field_names[i]);
+            printf(" %10s %9s %9s %10s %10s", name[0], name[1], name[2], name[3], name[4]);
+        }
+        puts("");
+    }
+
+    int64_t start = deadline;
+    for (long n = 0; (count == 0 || n < count) && !should_stop; n++) {
+        struct mem_info info;
+        if (sysinfo_meminfo(&info)) {
+            return 1;
+        }
+        int64_t now = monotonic_ns();
+
+        if (binary) {
+            struct sample_record rec = {.time_ns = now - start, .info = info};
+            if (fwrite(&rec, sizeof(rec), 1, stdout) != 1) {
+                return 1;
+            }
+        } else {
+            int64_t values[TRACKED_FIELDS];
+            tracked_values(&info, values);
+            double elapsed = n == 0 ? 0 : (now - prev_time) / 1e9;
+            int64_t delta[TRACKED_FIELDS];
+            for (int i = 0; i < TRACKED_FIELDS; i++) {
+                delta[i] = n == 0 ? 0 : values[i] - prev[i];
+                if (n == 0 || values[i] < min[i]) {
+                    min[i] = values[i];
+                }
+                if (n == 0 || values[i] > max[i]) {
+                    max[i] = values[i];
+                }
+                prev[i] = values[i];
+            }
+
+            printf("%8.2f", (now - start) / 1e9);
+            for (int i = 0; i < TRACKED_FIELDS; i++) {
+                printf(" %10ld %+9ld %9.1f %10ld %10ld", values[i] / 1000, delta[i] / 1000,
+                       elapsed ? delta[i] / 1000 / elapsed : 0, min[i] / 1000, max[i] / 1000);
+            }
+            puts("");
+        }
+        fflush(stdout);
+        prev_time = now;
+
+        if (count != 0 && n + 1 == count) {
+            break;
+        }
+        deadline += interval_ns;
+        if (now >= deadline) {
+            deadline += ((now - deadline) / interval_ns + 1) * interval_ns;
+        }
+        struct timespec wake = {
+            .tv_sec  = deadline / 1000000000LL,
+            .tv_nsec = deadline % 1000000000LL
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR &&
+               !should_stop);
+    }
+
+    if (!binary && prev_time != 0) {
+        puts("");
+        for (int i = 0; i < TRACKED_FIELDS; i++) {
+            printf("%-7s min %10ld kB  max %10ld kB\n", field_names[i],
+                   min[i] / 1000, max[i] / 1000);
+        }
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     int print_only_free  = 0;
     int print_only_used  = 0;
     int print_only_avail = 0;
     int print_only_total = 0;
+    double interval      = 0;
+    long count           = 0;
+    bool binary          = false;
 
     char c;
-    while ((c = getopt (argc, argv, "hfutv")) != -1) {
+    while ((c = getopt (argc, argv, "hfutivs:c:b")) != -1) {
         switch (c) {
             case 'h':
                 puts("Usage: showmem [options]");
@@ -53,11 +173,33 @@ int main(int argc, char *argv[]) {
                 puts("-t      Print available memory (in MiB)");
                 puts("-i      Print total installed system memory (in MiB)");
                 puts("-v      Display version information.");
+                puts("-s <s>  Sample every s seconds, printing deltas, rates and extremes");
+                puts("-c <n>  Stop sampling after n samples");
+                puts("-b      Write samples as binary records instead of text");
                 return 0;
             case 'f': print_only_free  = 1; break;
             case 'u': print_only_used  = 1; break;
             case 't': print_only_avail = 1; break;
             case 'i': print_only_total = 1; break;
+            case 's': {
+               char *end;
+               interval = strtod(optarg, &end);
+               if (*optarg == '\0' || *end != '\0' || !isfinite(interval) || interval <= 0) {
+                   fprintf(stderr, "showmem: '%s' is not a valid interval\n", optarg);
+                   return 1;
+               }
+               break;
+            }
+            case 'c': {
+               char *end;
+               count = strtol(optarg, &end, 10);
+               if (*optarg == '\0' || *end != '\0' || count <= 0) {
+                   fprintf(stderr, "showmem: '%s' is not a valid sample count\n", optarg);
+                   return 1;
+               }
+               break;
+            }
+            case 'b': binary = true; break;
             case 'v':
                puts("showmem" VERSION_STR);
                return 0;
@@ -67,34 +209,29 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    int ret, errno;
-    struct mem_info meminfo;
-    SYSCALL1(SYSCALL_MEMINFO, &meminfo);
-    if (ret != 0) {
+    if (interval != 0) {
+        return sample(interval, count, binary);
+    } else if (count != 0) {
+        fprintf(stderr, "showmem: -c only works with -s\n");
         return 1;
     }
 
-    // Translate all values to kilobytes.
-    const long free       = meminfo.phys_free      / 1000;
-    const long available  = meminfo.phys_available / 1000;
-    const long total      = meminfo.phys_total     / 1000;
-
-    if (print_only_free)       { printf("%lu\n", free / 1000);               }
-    else if (print_only_used)  { printf("%lu\n", (available - free) / 1000); }
-    else if (print_only_avail) { printf("%lu\n", available / 1000);          }
-    else if (print_only_total) { printf("%lu\n", total / 1000);              }
-    else {
-        const int width = round(1 + log(total) / log(10));
-
-        printf("Free memory:      %*lu kB\n", width, free);
-        printf("Used memory:      %*lu kB\n", width, available - free);
-        printf("Available memory: %*lu kB\n", width, available);
-        printf("Total memory:     %*lu kB\n", width, total);
-        printf("Shared memory:    %*lu kB\n", width, meminfo.shared_usage / 1000);
-        printf("Kernel memory:    %*lu kB\n", width, meminfo.kernel_usage / 1000);
-        printf("Table memory:     %*lu kB\n", width, meminfo.table_usage  / 1000);
-        printf("Poisoned memory:  %*lu kB\n", width, meminfo.poison_usage / 1000);
+    struct mem_info meminfo;
+    if (sysstat_meminfo(&meminfo)) {
+        return 1;
     }
 
+    // Translate all values to MiB.
+    const uint64_t free       = meminfo.phys_free      >> 20;
+    const uint64_t available  = meminfo.phys_available >> 20;
+    const uint64_t used       = (meminfo.phys_available - meminfo.phys_free) >> 20;
+    const uint64_t total      = meminfo.phys_total     >> 20;
+
+    if (print_only_free)       { printf("%lu\n", free);                   }
+    else if (print_only_used)  { printf("%lu\n", used);                   }
+    else if (print_only_avail) { printf("%lu\n", available);              }
+    else if (print_only_total) { printf("%lu\n", total);                  }
+    else                       { sysinfo_print_meminfo(stdout, &meminfo); }
+
    return 0;
 }
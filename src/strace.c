@@ -32,6 +32,14 @@
 #include <sys/wait.h>
 #include <inttypes.h>
 #include <poll.h>
+#include <getopt.h>
+#include <signal.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <elfsym.h>
+#include <execpath.h>
 
 struct registers {
     uint64_t rax;
@@ -60,6 +68,8 @@ struct registers {
 struct thread_info {
     uint16_t tid;
     int is_syscall;
+    uint64_t syscall; // Syscall in flight when is_syscall is false.
+    uint64_t arg;     // Its first argument, for the ones returning in memory.
 };
 
 struct syscall_info {
@@ -219,11 +229,1386 @@ static void print_error(FILE *out, struct registers state) {
     }
 }
 
+// Request for ptrace to send the syscall records of a process to a pipe.
+#define PTRACE_SYSCALL_PIPE 1
+// Request for ptrace to read a word of the memory of a process.
+#define PTRACE_PEEK_DATA 2
+
+// Read memory of a tracee a word at a time. The tracee keeps running while we
+// trace it, so this is done as soon as the record that needs it arrives.
+static int read_tracee(pid_t pid, uint64_t address, void *buffer, size_t length) {
+    unsigned char *dest = buffer;
+    for (size_t done = 0; done < length; done += sizeof(uint64_t)) {
+        uint64_t word;
+        long ret, errno;
+        SYSCALL4(SYSCALL_PTRACE, PTRACE_PEEK_DATA, pid, address + done, &word);
+        if (ret) {
+            return -1;
+        }
+        size_t chunk = length - done < sizeof(word) ? length - done : sizeof(word);
+        memcpy(dest + done, &word, chunk);
+    }
+    return 0;
+}
+
+// What ptrace writes to the pipe for every syscall entry and exit.
+struct trace_record {
+    uint16_t tid;
+    struct registers state;
+} __attribute__((packed));
+
+#define RECORDS_PER_READ 64
+
+// A process being traced, every one of them gets its own pipe. Records are
+// read in batches, so we keep whatever partial record a read leaves behind.
+struct tracee {
+    pid_t pid;
+    int fd;
+    bool done;
+    bool is_child;
+    int status;       // waitpid status for our child, exit code otherwise.
+    bool has_status;
+    size_t buffered;
+    unsigned char buffer[RECORDS_PER_READ * sizeof(struct trace_record)];
+};
+
+static int tracee_count = 0;
+static struct tracee *tracees = NULL;
+
+// Slot 0 of the poll set is the signal self-pipe, the rest are the tracees
+// in the same order as the tracees array.
+static struct pollfd *polled = NULL;
+static int signal_pipe[2];
+
+// We keep an array as well for each thread we find in order to know how
+// to continue syscalls without being nonsensical.
+static int thread_count = 0;
+static struct thread_info *infos = NULL;
+
+static FILE *out;
+static bool follow_children = false;
+
+// The main thread only drains the tracee pipes into a single-producer,
+// single-consumer ring of events, formatting and writing is done by a
+// separate writer thread, so a slow output never backs up the tracees.
+enum event_kind {
+    EVENT_ENTRY,    // A syscall was entered.
+    EVENT_EXIT,     // A syscall returned.
+    EVENT_EXITED,   // The process exited with the code in status.
+    EVENT_KILLED,   // The process was killed by the signal in status.
+    EVENT_DETACHED, // The process is gone without us knowing why.
+    EVENT_DUMP      // SIGUSR1 asked for a flight recorder dump.
+};
+
+#define FUTEX_MAX_ITEMS 8 // Only this many items of a futex call are accounted.
+
+struct trace_event {
+    enum event_kind kind;
+    pid_t pid;
+    uint16_t tid;
+    int status;
+    uint64_t syscall; // For EVENT_EXIT, the syscall that is returning.
+    uint64_t time;    // Monotonic ns when read, only for modes that need it.
+    struct registers state;
+
+    // Tracee memory a mode needs, read by the main thread as the record comes
+    // in, by the time the writer gets to the event the tracee moved on.
+    union {
+        struct {
+            bool unreadable;
+            uint8_t count;
+            uint64_t addresses[FUTEX_MAX_ITEMS];
+        } futex; // Entries of futex, for MODE_FUTEX.
+        struct {
+            bool unreadable;
+            int fds[2];
+        } pipe;  // Successful exits of pipe, for MODE_IO.
+    } peeked;
+};
+
+#define RING_EVENTS 4096 // Must be a power of 2.
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+static struct trace_event ring[RING_EVENTS];
+static atomic_size_t ring_head = 0;    // Written by the reader only.
+static atomic_size_t ring_tail = 0;    // Written by the writer only.
+static atomic_ulong dropped_events = 0;
+static atomic_bool writer_sleeping = false;
+static atomic_bool reader_done = false;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+
+// What the writer does with the events it consumes.
+enum trace_mode {
+    MODE_PRINT,   // Print everything as it comes.
+    MODE_RING,    // Flight recorder, keep the last events and dump on demand.
+    MODE_PROFILE, // Aggregate syscalls by call site and report at exit.
+    MODE_IO,      // Analyze I/O patterns by file descriptor.
+    MODE_FUTEX,   // Profile lock contention through futex.
+    MODE_MMAP     // Track memory mapping churn.
+};
+
+static enum trace_mode mode = MODE_PRINT;
+static bool need_timestamps = false;
+
+static bool ring_push(const struct trace_event *event) {
+    size_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    if (head - tail == RING_EVENTS) {
+        return false;
+    }
+
+    ring[head & (RING_EVENTS - 1)] = *event;
+    atomic_store(&ring_head, head + 1);
+    return true;
+}
+
+// Wake the writer if it went to sleep, this is done once per batch of events
+// instead of once per event.
+static void ring_wake(void) {
+    if (atomic_load(&writer_sleeping)) {
+        pthread_mutex_lock(&writer_lock);
+        atomic_store(&writer_sleeping, false);
+        pthread_cond_signal(&writer_cond);
+        pthread_mutex_unlock(&writer_lock);
+    }
+}
+
+// When the ring is full, syscall events are dropped and counted while
+// printing or recording, so that a slow output never holds the tracees back.
+// The analysis modes would silently skew their totals and pair the wrong
+// calls, and losing the end of a process is never an option, so for those
+// we wait.
+static void push_event(const struct trace_event *event) {
+    bool lossy = mode == MODE_PRINT || mode == MODE_RING;
+    if (lossy && (event->kind == EVENT_ENTRY || event->kind == EVENT_EXIT)) {
+        if (!ring_push(event)) {
+            atomic_fetch_add(&dropped_events, 1);
+        }
+    } else {
+        while (!ring_push(event)) {
+            ring_wake();
+            sched_yield();
+        }
+    }
+}
+
+static void print_event(struct trace_event *event) {
+    if (follow_children) {
+        fprintf(out, "[pid %d] ", event->pid);
+    }
+    switch (event->kind) {
+        case EVENT_ENTRY:
+            fprintf(out, "%d: ", event->tid);
+            print_syscall(out, event->state);
+            fprintf(out, "\n");
+            break;
+        case EVENT_EXIT:
+            fprintf(out, "\t%d: ", event->tid);
+            print_error(out, event->state);
+            fprintf(out, "\n");
+            break;
+        case EVENT_EXITED:
+            fprintf(out, "+++ exited with %d +++\n", event->status);
+            break;
+        case EVENT_KILLED:
+            fprintf(out, "+++ killed by signal %d +++\n", event->status);
+            break;
+        case EVENT_DETACHED:
+            fprintf(out, "+++ detached +++\n");
+            break;
+        case EVENT_DUMP:
+            break;
+    }
+}
+
+// In flight recorder mode every thread gets a preallocated ring of its last
+// raw events, which are only formatted when something asks for a dump.
+struct recorder {
+    uint16_t tid;
+    pid_t pid;
+    uint64_t seen;
+    struct trace_event *events;
+};
+
+static size_t recorder_size = 0;
+static int64_t recorder_trigger = -1;
+static int recorder_count = 0;
+static struct recorder *recorders = NULL;
+
+static struct recorder *get_recorder(struct trace_event *event) {
+    for (int i = 0; i < recorder_count; i++) {
+        if (recorders[i].tid == event->tid) {
+            return &recorders[i];
+        }
+    }
+
+    recorders = realloc(recorders, (recorder_count + 1) * sizeof(struct recorder));
+    if (recorders == NULL) {
+        perror("strace: could not allocate recorder");
+        exit(1);
+    }
+    struct recorder *new = &recorders[recorder_count++];
+    new->tid = event->tid;
+    new->pid = event->pid;
+    new->seen = 0;
+    new->events = malloc(recorder_size * sizeof(struct trace_event));
+    if (new->events == NULL) {
+        perror("strace: could not allocate recorder");
+        exit(1);
+    }
+    return new;
+}
+
+static void dump_recorders(const char *reason) {
+    fprintf(out, "=== flight recorder dump: %s ===\n", reason);
+    for (int i = 0; i < recorder_count; i++) {
+        struct recorder *rec = &recorders[i];
+        uint64_t kept = rec->seen < recorder_size ? rec->seen : recorder_size;
+        fprintf(out, "--- thread %d of pid %d, last %lu of %lu events ---\n",
+                rec->tid, rec->pid, kept, rec->seen);
+        for (uint64_t j = rec->seen - kept; j < rec->seen; j++) {
+            print_event(&rec->events[j % recorder_size]);
+        }
+    }
+    fprintf(out, "=== end of dump ===\n");
+    fflush(out);
+}
+
+static void record_event(struct trace_event *event) {
+    char reason[64];
+    switch (event->kind) {
+        case EVENT_ENTRY:
+        case EVENT_EXIT: {
+            struct recorder *rec = get_recorder(event);
+            rec->events[rec->seen++ % recorder_size] = *event;
+            if (event->kind == EVENT_EXIT && event->state.rdx != 0 &&
+                (int64_t)event->syscall == recorder_trigger) {
+                snprintf(reason, sizeof(reason), "thread %d failed syscall %lu",
+                         event->tid, event->syscall);
+                dump_recorders(reason);
+            }
+            break;
+        }
+        case EVENT_EXITED:
+            if (event->status != 0) {
+                snprintf(reason, sizeof(reason), "pid %d exited with %d",
+                         event->pid, event->status);
+                dump_recorders(reason);
+            }
+            break;
+        case EVENT_KILLED:
+            snprintf(reason, sizeof(reason), "pid %d killed by signal %d",
+                     event->pid, event->status);
+            dump_recorders(reason);
+            break;
+        case EVENT_DETACHED:
+            break;
+        case EVENT_DUMP:
+            dump_recorders("SIGUSR1");
+            break;
+    }
+}
+
+// Analysis modes pair every syscall exit with the entry of the same thread,
+// which is kept here, as exit records do not carry the arguments.
+struct pending_call {
+    uint16_t tid;
+    bool valid;
+    struct trace_event entry;
+};
+
+static int pending_count = 0;
+static struct pending_call *pendings = NULL;
+
+static struct pending_call *get_pending(uint16_t tid) {
+    for (int i = 0; i < pending_count; i++) {
+        if (pendings[i].tid == tid) {
+            return &pendings[i];
+        }
+    }
+
+    pendings = realloc(pendings, (pending_count + 1) * sizeof(struct pending_call));
+    if (pendings == NULL) {
+        perror("strace: could not allocate thread information");
+        exit(1);
+    }
+    pendings[pending_count].tid = tid;
+    pendings[pending_count].valid = false;
+    return &pendings[pending_count++];
+}
+
+// Returns the entry matching an exit event, or NULL if we did not see it.
+static struct trace_event *pair_event(struct trace_event *event) {
+    struct pending_call *pending = get_pending(event->tid);
+    if (event->kind == EVENT_ENTRY) {
+        pending->entry = *event;
+        pending->valid = true;
+        return NULL;
+    } else if (event->kind == EVENT_EXIT && pending->valid) {
+        pending->valid = false;
+        return &pending->entry;
+    }
+    return NULL;
+}
+
+// Statistics aggregated by a pair of keys, kept in an open addressing hash
+// table, which is grown when 3/4 full.
+struct site_stats {
+    uint64_t key_a;
+    uint64_t key_b;
+    bool used;
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t aux[4]; // Mode specific.
+};
+
+struct site_table {
+    size_t size; // Power of 2.
+    size_t used;
+    struct site_stats *entries;
+};
+
+static uint64_t hash_keys(uint64_t a, uint64_t b) {
+    uint64_t hash = a * 0x9e3779b97f4a7c15 ^ (b + 0x632be59bd9b4e019);
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9;
+    return hash ^ (hash >> 32);
+}
+
+static struct site_stats *site_get(struct site_table *table, uint64_t a, uint64_t b) {
+    if ((table->used + 1) * 4 > table->size * 3) {
+        size_t new_size = table->size == 0 ? 256 : table->size * 2;
+        struct site_stats *new_entries = calloc(new_size, sizeof(struct site_stats));
+        if (new_entries == NULL) {
+            perror("strace: could not allocate site table");
+            exit(1);
+        }
+        for (size_t i = 0; i < table->size; i++) {
+            if (table->entries[i].used) {
+                size_t idx = hash_keys(table->entries[i].key_a, table->entries[i].key_b);
+                while (new_entries[idx & (new_size - 1)].used) {
+                    idx++;
+                }
+                new_entries[idx & (new_size - 1)] = table->entries[i];
+            }
+        }
+        free(table->entries);
+        table->entries = new_entries;
+        table->size = new_size;
+    }
+
+    size_t idx = hash_keys(a, b);
+    for (;; idx++) {
+        struct site_stats *entry = &table->entries[idx & (table->size - 1)];
+        if (!entry->used) {
+            entry->used = true;
+            entry->key_a = a;
+            entry->key_b = b;
+            table->used++;
+            return entry;
+        } else if (entry->key_a == a && entry->key_b == b) {
+            return entry;
+        }
+    }
+}
+
+// Compact the used entries at the start of the table, for sorting.
+static size_t site_compact(struct site_table *table) {
+    size_t count = 0;
+    for (size_t i = 0; i < table->size; i++) {
+        if (table->entries[i].used) {
+            table->entries[count++] = table->entries[i];
+        }
+    }
+    return count;
+}
+
+static int compare_total(const void *a, const void *b) {
+    const struct site_stats *sa = a, *sb = b;
+    if (sa->total_ns != sb->total_ns) {
+        return sa->total_ns > sb->total_ns ? -1 : 1;
+    }
+    if (sa->count != sb->count) {
+        return sa->count > sb->count ? -1 : 1;
+    }
+    return 0;
+}
+
+static char *executable_path = NULL;
+static struct elf_symbols symbols;
+static bool have_symbols = false;
+
+static void load_symbols(void) {
+    if (executable_path != NULL && !elfsym_load(&symbols, executable_path)) {
+        // We cannot know where a PIE was loaded, so do not guess.
+        have_symbols = !symbols.is_pie;
+        if (symbols.is_pie) {
+            fprintf(out, "%s is position independent, sites left unsymbolized\n",
+                    executable_path);
+        }
+    }
+}
+
+static void print_site(uint64_t addr) {
+    const struct elf_symbol *sym = have_symbols ? elfsym_lookup(&symbols, addr) : NULL;
+    if (sym != NULL) {
+        fprintf(out, "%s+0x%lx", sym->name, addr - sym->addr);
+    } else {
+        fprintf(out, "0x%lx", addr);
+    }
+}
+
+// Call site profiler, aggregating count and latency by (syscall, rip).
+static struct site_table profile_sites;
+static size_t profile_shown = 30;
+
+static void profile_event(struct trace_event *event) {
+    struct trace_event *entry = pair_event(event);
+    if (entry == NULL) {
+        return;
+    }
+
+    struct site_stats *site = site_get(&profile_sites, entry->state.rax, entry->state.rip);
+    uint64_t elapsed = event->time - entry->time;
+    site->count++;
+    site->total_ns += elapsed;
+    if (elapsed > site->max_ns) {
+        site->max_ns = elapsed;
+    }
+}
+
+static void profile_report(void) {
+    size_t count = site_compact(&profile_sites);
+    qsort(profile_sites.entries, count, sizeof(struct site_stats), compare_total);
+
+    load_symbols();
+    fprintf(out, "Hottest syscall call sites:\n");
+    fprintf(out, "%10s %12s %10s %10s %-20s %s\n", "CALLS", "TOTAL(us)",
+            "AVG(us)", "MAX(us)", "SYSCALL", "SITE");
+    for (size_t i = 0; i < count && i < profile_shown; i++) {
+        struct site_stats *site = &profile_sites.entries[i];
+        fprintf(out, "%10lu %12lu %10lu %10lu ", site->count, site->total_ns / 1000,
+                site->total_ns / site->count / 1000, site->max_ns / 1000);
+        if (site->key_a <= MAX_SYSCALL_IDX && syscalls[site->key_a].name != NULL) {
+            fprintf(out, "%-20s ", syscalls[site->key_a].name);
+        } else {
+            fprintf(out, "%-20lu ", site->key_a);
+        }
+        print_site(site->key_b);
+        fprintf(out, "\n");
+    }
+}
+
+// I/O pattern analyzer. Every lifetime of a file descriptor, from the
+// syscall that returned it to its close, gets its own statistics, indexed
+// by (pid, fd) in a site table whose aux[0] is 1 + the index of the lifetime.
+#define IO_BUCKETS 6
+#define IO_SMALL_SIZE 4096
+#define IO_SMALL_MIN_CALLS 16
+
+static const uint64_t io_bucket_limits[IO_BUCKETS - 1] = {64, 512, 4096, 32768, 262144};
+static const char *io_bucket_names[IO_BUCKETS] = {"<64", "<512", "<4K", "<32K", "<256K", ">=256K"};
+
+struct fd_stats {
+    pid_t pid;
+    uint64_t fd;
+    const char *origin;
+    uint64_t calls;
+    uint64_t failed;
+    uint64_t requested;
+    uint64_t transferred;
+    uint64_t small;
+    uint64_t histogram[IO_BUCKETS];
+};
+
+struct thread_io {
+    uint16_t tid;
+    pid_t pid;
+    uint64_t calls;
+    uint64_t requested;
+    uint64_t transferred;
+    uint64_t small;
+};
+
+static struct site_table io_live;
+static size_t io_fd_count = 0;
+static struct fd_stats *io_fds = NULL;
+static int io_thread_count = 0;
+static struct thread_io *io_threads = NULL;
+
+static struct fd_stats *io_open_fd(pid_t pid, uint64_t fd, const char *origin) {
+    io_fds = realloc(io_fds, (io_fd_count + 1) * sizeof(struct fd_stats));
+    if (io_fds == NULL) {
+        perror("strace: could not allocate fd statistics");
+        exit(1);
+    }
+    struct fd_stats *stats = &io_fds[io_fd_count++];
+    memset(stats, 0, sizeof(struct fd_stats));
+    stats->pid = pid;
+    stats->fd = fd;
+    stats->origin = origin;
+    site_get(&io_live, pid, fd)->aux[0] = io_fd_count;
+    return stats;
+}
+
+// Descriptors we did not see being created, like inherited ones or the ones
+// of a pipe whose result could not be read, are picked up when first used.
+static struct fd_stats *io_get_fd(pid_t pid, uint64_t fd) {
+    struct site_stats *live = site_get(&io_live, pid, fd);
+    if (live->aux[0] == 0) {
+        return io_open_fd(pid, fd, fd <= 2 ? "stdio" : "unknown");
+    }
+    return &io_fds[live->aux[0] - 1];
+}
+
+static struct thread_io *io_get_thread(struct trace_event *event) {
+    for (int i = 0; i < io_thread_count; i++) {
+        if (io_threads[i].tid == event->tid) {
+            return &io_threads[i];
+        }
+    }
+
+    io_threads = realloc(io_threads, (io_thread_count + 1) * sizeof(struct thread_io));
+    if (io_threads == NULL) {
+        perror("strace: could not allocate thread statistics");
+        exit(1);
+    }
+    struct thread_io *new = &io_threads[io_thread_count++];
+    memset(new, 0, sizeof(struct thread_io));
+    new->tid = event->tid;
+    new->pid = event->pid;
+    return new;
+}
+
+static void io_event(struct trace_event *event) {
+    struct trace_event *entry = pair_event(event);
+    if (entry == NULL) {
+        return;
+    }
+
+    pid_t pid = entry->pid;
+    struct registers *args = &entry->state;
+    bool failed = event->state.rdx != 0;
+    uint64_t result = event->state.rax;
+
+    switch (args->rax) {
+        case SYSCALL_OPEN:
+        case SYSCALL_SOCKET:
+        case SYSCALL_ACCEPT:
+            if (!failed) {
+                io_open_fd(pid, result, syscalls[args->rax].name);
+            }
+            break;
+        case SYSCALL_PIPE:
+            if (!failed && !event->peeked.pipe.unreadable) {
+                io_open_fd(pid, event->peeked.pipe.fds[0], "pipe");
+                io_open_fd(pid, event->peeked.pipe.fds[1], "pipe");
+            }
+            break;
+        case SYSCALL_FCNTL:
+            if (!failed && (args->rsi == F_DUPFD || args->rsi == F_DUPFD_CLOEXEC)) {
+                io_open_fd(pid, result, "dup");
+            }
+            break;
+        case SYSCALL_CLOSE:
+            if (!failed) {
+                site_get(&io_live, pid, args->rdi)->aux[0] = 0;
+            }
+            break;
+        case SYSCALL_READ:
+        case SYSCALL_WRITE:
+        case SYSCALL_PREAD:
+        case SYSCALL_PWRITE:
+        case SYSCALL_RECVFROM:
+        case SYSCALL_SENDTO: {
+            struct fd_stats *stats = io_get_fd(pid, args->rdi);
+            struct thread_io *thread = io_get_thread(entry);
+            stats->calls++;
+            stats->requested += args->rdx;
+            thread->calls++;
+            thread->requested += args->rdx;
+            if (failed) {
+                stats->failed++;
+                break;
+            }
+
+            int bucket = 0;
+            while (bucket < IO_BUCKETS - 1 && result >= io_bucket_limits[bucket]) {
+                bucket++;
+            }
+            stats->histogram[bucket]++;
+            stats->transferred += result;
+            thread->transferred += result;
+            if (result < IO_SMALL_SIZE) {
+                stats->small++;
+                thread->small++;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static int compare_fd_calls(const void *a, const void *b) {
+    const struct fd_stats *sa = a, *sb = b;
+    if (sa->calls != sb->calls) {
+        return sa->calls > sb->calls ? -1 : 1;
+    }
+    return 0;
+}
+
+// An fd is flagged when most of its successful transfers are small.
+static bool io_is_small(uint64_t calls, uint64_t failed, uint64_t small) {
+    uint64_t succeeded = calls - failed;
+    return succeeded >= IO_SMALL_MIN_CALLS && small * 2 > succeeded;
+}
+
+static void io_report(void) {
+    qsort(io_fds, io_fd_count, sizeof(struct fd_stats), compare_fd_calls);
+
+    fprintf(out, "I/O by file descriptor:\n");
+    fprintf(out, "%5s %4s %-8s %8s %12s %12s %8s", "PID", "FD", "ORIGIN",
+            "CALLS", "REQUESTED", "TRANSFERRED", "AVG");
+    for (int i = 0; i < IO_BUCKETS; i++) {
+        fprintf(out, " %7s", io_bucket_names[i]);
+    }
+    fprintf(out, "\n");
+
+    int flagged = 0;
+    for (size_t i = 0; i < io_fd_count; i++) {
+        struct fd_stats *stats = &io_fds[i];
+        if (stats->calls == 0) {
+            continue;
+        }
+
+        uint64_t succeeded = stats->calls - stats->failed;
+        fprintf(out, "%5d %4lu %-8s %8lu %12lu %12lu %8lu", stats->pid, stats->fd,
+                stats->origin, stats->calls, stats->requested, stats->transferred,
+                succeeded != 0 ? stats->transferred / succeeded : 0);
+        for (int j = 0; j < IO_BUCKETS; j++) {
+            fprintf(out, " %7lu", stats->histogram[j]);
+        }
+        if (io_is_small(stats->calls, stats->failed, stats->small)) {
+            fprintf(out, " SMALL-IO");
+            flagged++;
+        }
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "\nI/O by thread:\n");
+    fprintf(out, "%5s %5s %8s %12s %12s %8s\n", "PID", "TID", "CALLS", "REQUESTED",
+            "TRANSFERRED", "SMALL");
+    for (int i = 0; i < io_thread_count; i++) {
+        struct thread_io *thread = &io_threads[i];
+        fprintf(out, "%5d %5d %8lu %12lu %12lu %8lu\n", thread->pid, thread->tid,
+                thread->calls, thread->requested, thread->transferred, thread->small);
+    }
+
+    if (flagged != 0) {
+        fprintf(out, "\n%d descriptors are dominated by transfers under %d bytes,\n"
+                "consider buffering their I/O.\n", flagged, IO_SMALL_SIZE);
+    }
+}
+
+// futex contention profiler. The kernel is passed the operation in rdi, and
+// in rsi and rdx an array of items and its length, every item holding the
+// address of a futex. The array is usually a temporary on the stack, so the
+// addresses are read from the tracee as the entry arrives, and waits and
+// wakes are aggregated both by address and by (address, rip) call site.
+#define FUTEX_OP_WAIT 1
+#define FUTEX_OP_WAKE 2
+
+// For both tables, count, total_ns and max_ns account waits, then:
+#define FUTEX_WAKES       0 // aux index of the number of wake calls.
+#define FUTEX_WOKEN       1 // aux index of the waiters woken by those.
+#define FUTEX_WAITING     2 // aux index of the current waiters, addresses only.
+#define FUTEX_MAX_WAITING 3 // aux index of the most waiters, addresses only.
+
+struct futex_item {
+    uint64_t address;
+    uint32_t expected;
+    uint32_t flags;
+} __attribute__((packed));
+
+static struct site_table futex_addrs;
+static struct site_table futex_sites;
+static size_t futex_shown = 20;
+static uint64_t futex_unreadable = 0;
+
+// Called by the main thread for every futex entry.
+static void futex_peek(struct trace_event *event) {
+    struct futex_item items[FUTEX_MAX_ITEMS];
+    size_t count = event->state.rdx < FUTEX_MAX_ITEMS ? event->state.rdx : FUTEX_MAX_ITEMS;
+    event->peeked.futex.count = 0;
+    event->peeked.futex.unreadable =
+        read_tracee(event->pid, event->state.rsi, items, count * sizeof(struct futex_item));
+    if (!event->peeked.futex.unreadable) {
+        for (size_t i = 0; i < count; i++) {
+            event->peeked.futex.addresses[i] = items[i].address;
+        }
+        event->peeked.futex.count = count;
+    }
+}
+
+static void futex_event(struct trace_event *event) {
+    if (event->kind == EVENT_ENTRY && event->state.rax == SYSCALL_FUTEX) {
+        futex_unreadable += event->peeked.futex.unreadable;
+        for (size_t i = 0; i < event->peeked.futex.count &&
+                           event->state.rdi == FUTEX_OP_WAIT; i++) {
+            struct site_stats *addr = site_get(&futex_addrs,
+                                               event->peeked.futex.addresses[i], 0);
+            addr->aux[FUTEX_WAITING]++;
+            if (addr->aux[FUTEX_WAITING] > addr->aux[FUTEX_MAX_WAITING]) {
+                addr->aux[FUTEX_MAX_WAITING] = addr->aux[FUTEX_WAITING];
+            }
+        }
+    }
+
+    struct trace_event *entry = pair_event(event);
+    if (entry == NULL || entry->state.rax != SYSCALL_FUTEX) {
+        return;
+    }
+
+    for (size_t i = 0; i < entry->peeked.futex.count; i++) {
+        uint64_t address = entry->peeked.futex.addresses[i];
+        struct site_stats *addr = site_get(&futex_addrs, address, 0);
+        struct site_stats *site = site_get(&futex_sites, address, entry->state.rip);
+        if (entry->state.rdi == FUTEX_OP_WAIT) {
+            uint64_t elapsed = event->time - entry->time;
+            if (addr->aux[FUTEX_WAITING] != 0) {
+                addr->aux[FUTEX_WAITING]--;
+            }
+            addr->count++;
+            addr->total_ns += elapsed;
+            site->count++;
+            site->total_ns += elapsed;
+            if (elapsed > addr->max_ns) {
+                addr->max_ns = elapsed;
+            }
+            if (elapsed > site->max_ns) {
+                site->max_ns = elapsed;
+            }
+        } else if (entry->state.rdi == FUTEX_OP_WAKE) {
+            addr->aux[FUTEX_WAKES]++;
+            site->aux[FUTEX_WAKES]++;
+            if (event->state.rdx == 0) {
+                addr->aux[FUTEX_WOKEN] += event->state.rax;
+                site->aux[FUTEX_WOKEN] += event->state.rax;
+            }
+        }
+    }
+}
+
+static void futex_report(void) {
+    size_t addr_count = site_compact(&futex_addrs);
+    size_t site_count = site_compact(&futex_sites);
+    qsort(futex_addrs.entries, addr_count, sizeof(struct site_stats), compare_total);
+    qsort(futex_sites.entries, site_count, sizeof(struct site_stats), compare_total);
+
+    load_symbols();
+    fprintf(out, "Most contended futexes:\n");
+    fprintf(out, "%-18s %8s %12s %10s %10s %8s %8s %8s\n", "ADDRESS", "WAITS",
+            "WAITED(us)", "AVG(us)", "MAX(us)", "WAKES", "WOKEN", "WAITERS");
+    for (size_t i = 0; i < addr_count && i < futex_shown; i++) {
+        struct site_stats *addr = &futex_addrs.entries[i];
+        fprintf(out, "0x%016lx %8lu %12lu %10lu %10lu %8lu %8lu %8lu\n", addr->key_a,
+                addr->count, addr->total_ns / 1000,
+                addr->count != 0 ? addr->total_ns / addr->count / 1000 : 0,
+                addr->max_ns / 1000, addr->aux[FUTEX_WAKES], addr->aux[FUTEX_WOKEN],
+                addr->aux[FUTEX_MAX_WAITING]);
+
+        for (size_t j = 0; j < site_count; j++) {
+            struct site_stats *site = &futex_sites.entries[j];
+            if (site->key_a != addr->key_a) {
+                continue;
+            }
+            fprintf(out, "  %8lu waits %10lu us %6lu wakes at ", site->count,
+                    site->total_ns / 1000, site->aux[FUTEX_WAKES]);
+            print_site(site->key_b);
+            fprintf(out, "\n");
+        }
+    }
+    if (futex_unreadable != 0) {
+        fprintf(out, "\n%lu calls were not accounted, their futex items could not be read\n",
+                futex_unreadable);
+    }
+}
+
+// Memory mapping churn tracker. Every process gets a sorted array of its live
+// mappings, binary searched and split as munmap punches holes, and a
+// timeline of its mappings with a bin per second.
+#define PAGE_SIZE_BYTES 4096
+#define MMAP_BIN_NS 1000000000
+#define MMAP_TIMELINE_ROWS 40
+
+struct mapping {
+    uint64_t start;
+    uint64_t end;
+    uint64_t mapped_at;
+};
+
+struct mmap_bin {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t maps;
+    uint64_t unmaps;
+};
+
+struct mmap_process {
+    pid_t pid;
+    size_t count;
+    size_t capacity;
+    struct mapping *mappings;
+    uint64_t bytes;
+    uint64_t peak_bytes;
+    uint64_t peak_count;
+    uint64_t maps;
+    uint64_t unmaps;
+    uint64_t mprotects;
+    uint64_t failed;
+    uint64_t short_lived;
+    uint64_t short_bytes;
+    uint64_t first_ns;
+    uint64_t last_ns;
+    size_t bin_count;
+    struct mmap_bin *bins;
+};
+
+static uint64_t mmap_short_ns = 10 * 1000000;
+static int mmap_process_count = 0;
+static struct mmap_process *mmap_processes = NULL;
+
+static struct mmap_process *mmap_get_process(pid_t pid, uint64_t now) {
+    for (int i = 0; i < mmap_process_count; i++) {
+        if (mmap_processes[i].pid == pid) {
+            return &mmap_processes[i];
+        }
+    }
+
+    mmap_processes = realloc(mmap_processes,
+        (mmap_process_count + 1) * sizeof(struct mmap_process));
+    if (mmap_processes == NULL) {
+        perror("strace: could not allocate mapping information");
+        exit(1);
+    }
+    struct mmap_process *new = &mmap_processes[mmap_process_count++];
+    memset(new, 0, sizeof(struct mmap_process));
+    new->pid = pid;
+    new->first_ns = now;
+    return new;
+}
+
+// Index of the first mapping ending past an address.
+static size_t mmap_find(struct mmap_process *proc, uint64_t addr) {
+    size_t low = 0, high = proc->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (proc->mappings[mid].end <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static void mmap_insert(struct mmap_process *proc, size_t idx, struct mapping mapping) {
+    if (proc->count == proc->capacity) {
+        proc->capacity = proc->capacity == 0 ? 64 : proc->capacity * 2;
+        proc->mappings = realloc(proc->mappings, proc->capacity * sizeof(struct mapping));
+        if (proc->mappings == NULL) {
+            perror("strace: could not allocate mapping information");
+            exit(1);
+        }
+    }
+    memmove(&proc->mappings[idx + 1], &proc->mappings[idx],
+            (proc->count - idx) * sizeof(struct mapping));
+    proc->mappings[idx] = mapping;
+    proc->count++;
+}
+
+static void mmap_unmap_range(struct mmap_process *proc, uint64_t start, uint64_t end,
+                             uint64_t now) {
+    size_t i = mmap_find(proc, start);
+    while (i < proc->count && proc->mappings[i].start < end) {
+        struct mapping *m = &proc->mappings[i];
+        if (m->start < start && m->end > end) {
+            struct mapping tail = {end, m->end, m->mapped_at};
+            m->end = start;
+            proc->bytes -= end - start;
+            mmap_insert(proc, i + 1, tail);
+            break;
+        } else if (m->start < start) {
+            proc->bytes -= m->end - start;
+            m->end = start;
+            i++;
+        } else if (m->end > end) {
+            proc->bytes -= end - m->start;
+            m->start = end;
+            break;
+        } else {
+            proc->bytes -= m->end - m->start;
+            if (now - m->mapped_at < mmap_short_ns) {
+                proc->short_lived++;
+                proc->short_bytes += m->end - m->start;
+            }
+            memmove(m, m + 1, (proc->count - i - 1) * sizeof(struct mapping));
+            proc->count--;
+        }
+    }
+}
+
+static void mmap_update_timeline(struct mmap_process *proc, uint64_t now,
+                                 bool mapped, bool unmapped) {
+    if (proc->bytes > proc->peak_bytes) {
+        proc->peak_bytes = proc->bytes;
+    }
+    if (proc->count > proc->peak_count) {
+        proc->peak_count = proc->count;
+    }
+    proc->last_ns = now;
+
+    size_t bin = (now - proc->first_ns) / MMAP_BIN_NS;
+    if (bin >= proc->bin_count) {
+        proc->bins = realloc(proc->bins, (bin + 1) * sizeof(struct mmap_bin));
+        if (proc->bins == NULL) {
+            perror("strace: could not allocate mapping timeline");
+            exit(1);
+        }
+        memset(&proc->bins[proc->bin_count], 0,
+               (bin + 1 - proc->bin_count) * sizeof(struct mmap_bin));
+        proc->bin_count = bin + 1;
+    }
+    proc->bins[bin].count = proc->count;
+    proc->bins[bin].bytes = proc->bytes;
+    proc->bins[bin].maps += mapped;
+    proc->bins[bin].unmaps += unmapped;
+}
+
+static void mmap_event(struct trace_event *event) {
+    struct trace_event *entry = pair_event(event);
+    if (entry == NULL) {
+        return;
+    }
+
+    uint64_t call = entry->state.rax;
+    if (call != SYSCALL_MMAP && call != SYSCALL_MUNMAP && call != SYSCALL_MPROTECT) {
+        return;
+    }
+
+    uint64_t now = event->time;
+    struct mmap_process *proc = mmap_get_process(entry->pid, now);
+    if (event->state.rdx != 0) {
+        proc->failed++;
+        return;
+    }
+
+    uint64_t length = (entry->state.rsi + PAGE_SIZE_BYTES - 1) & ~(uint64_t)(PAGE_SIZE_BYTES - 1);
+    if (call == SYSCALL_MMAP) {
+        // Fixed mappings can replace what was there before.
+        uint64_t start = event->state.rax;
+        mmap_unmap_range(proc, start, start + length, now);
+        struct mapping mapping = {start, start + length, now};
+        mmap_insert(proc, mmap_find(proc, start), mapping);
+        proc->bytes += length;
+        proc->maps++;
+        mmap_update_timeline(proc, now, true, false);
+    } else if (call == SYSCALL_MUNMAP) {
+        uint64_t start = entry->state.rdi;
+        mmap_unmap_range(proc, start, start + length, now);
+        proc->unmaps++;
+        mmap_update_timeline(proc, now, false, true);
+    } else {
+        proc->mprotects++;
+    }
+}
+
+static void mmap_report(void) {
+    fprintf(out, "Memory mapping churn:\n");
+    for (int i = 0; i < mmap_process_count; i++) {
+        struct mmap_process *proc = &mmap_processes[i];
+        double seconds = (double)(proc->last_ns - proc->first_ns) / 1000000000;
+        double rate = seconds > 0 ? (proc->maps + proc->unmaps) / seconds : 0;
+
+        fprintf(out, "pid %d: %lu maps, %lu unmaps, %lu mprotects, %lu failed in %.1fs (%.1f maps+unmaps/s)\n",
+                proc->pid, proc->maps, proc->unmaps, proc->mprotects, proc->failed,
+                seconds, rate);
+        fprintf(out, "  live: %zu mappings, %lu bytes; peak: %lu mappings, %lu bytes\n",
+                proc->count, proc->bytes, proc->peak_count, proc->peak_bytes);
+        fprintf(out, "  short-lived (under %lu ms): %lu mappings, %lu bytes (%lu%% of maps)\n",
+                mmap_short_ns / 1000000, proc->short_lived, proc->short_bytes,
+                proc->maps != 0 ? proc->short_lived * 100 / proc->maps : 0);
+
+        if (proc->bin_count == 0) {
+            continue;
+        }
+
+        // Bins we have no events for carry over the previous state.
+        size_t step = (proc->bin_count + MMAP_TIMELINE_ROWS - 1) / MMAP_TIMELINE_ROWS;
+        struct mmap_bin last = {0};
+        fprintf(out, "  %8s %10s %14s %8s %8s\n", "TIME(s)", "MAPPINGS", "BYTES",
+                "MAPS", "UNMAPS");
+        for (size_t b = 0; b < proc->bin_count; b += step) {
+            uint64_t maps = 0, unmaps = 0;
+            for (size_t j = b; j < b + step && j < proc->bin_count; j++) {
+                if (proc->bins[j].maps != 0 || proc->bins[j].unmaps != 0) {
+                    last = proc->bins[j];
+                }
+                maps += proc->bins[j].maps;
+                unmaps += proc->bins[j].unmaps;
+            }
+            fprintf(out, "  %8zu %10lu %14lu %8lu %8lu\n", b, last.count, last.bytes,
+                    maps, unmaps);
+        }
+    }
+}
+
+static void consume_event(struct trace_event *event) {
+    switch (mode) {
+        case MODE_PRINT:
+            print_event(event);
+            break;
+        case MODE_RING:
+            record_event(event);
+            break;
+        case MODE_PROFILE:
+            profile_event(event);
+            break;
+        case MODE_IO:
+            io_event(event);
+            break;
+        case MODE_FUTEX:
+            futex_event(event);
+            break;
+        case MODE_MMAP:
+            mmap_event(event);
+            break;
+    }
+}
+
+// Print whatever the mode accumulated once the writer is done with events.
+static void finish_mode(void) {
+    switch (mode) {
+        case MODE_PRINT:
+        case MODE_RING:
+            break;
+        case MODE_PROFILE:
+            profile_report();
+            break;
+        case MODE_IO:
+            io_report();
+            break;
+        case MODE_FUTEX:
+            futex_report();
+            break;
+        case MODE_MMAP:
+            mmap_report();
+            break;
+    }
+    fflush(out);
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    unsigned long reported_drops = 0;
+
+    for (;;) {
+        size_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+
+        if (tail == head) {
+            // Nothing to do, flush the batch we built and sleep, checking
+            // again after announcing it so no wakeup can be lost.
+            fflush(out);
+            if (atomic_load(&reader_done)) {
+                if (atomic_load(&ring_head) == tail) {
+                    break;
+                }
+                continue;
+            }
+            pthread_mutex_lock(&writer_lock);
+            atomic_store(&writer_sleeping, true);
+            while (atomic_load(&writer_sleeping) &&
+                   atomic_load(&ring_head) == tail &&
+                   !atomic_load(&reader_done)) {
+                pthread_cond_wait(&writer_cond, &writer_lock);
+            }
+            atomic_store(&writer_sleeping, false);
+            pthread_mutex_unlock(&writer_lock);
+            continue;
+        }
+
+        unsigned long drops = atomic_load(&dropped_events);
+        if (drops != reported_drops) {
+            fprintf(out, "... %lu events dropped ...\n", drops - reported_drops);
+            reported_drops = drops;
+        }
+
+        for (; tail != head; tail++) {
+            consume_event(&ring[tail & (RING_EVENTS - 1)]);
+        }
+        atomic_store_explicit(&ring_tail, tail, memory_order_release);
+    }
+
+    finish_mode();
+    return NULL;
+}
+
+static void signal_handler(int sig) {
+    int saved_errno = errno;
+    char byte = sig;
+    write(signal_pipe[1], &byte, 1);
+    errno = saved_errno;
+}
+
+static int attach_tracee(pid_t pid, bool is_child) {
+    int ret, errno;
+    int pipes[2];
+    if (pipe(pipes)) {
+        perror("strace: Could not create pipes");
+        return -1;
+    }
+
+    SYSCALL4(SYSCALL_PTRACE, PTRACE_SYSCALL_PIPE, pid, 0, pipes[1]);
+    close(pipes[1]);
+    if (ret) {
+        fprintf(stderr, "strace: Could not trace %d: %s\n", pid, strerror(errno));
+        close(pipes[0]);
+        return -1;
+    }
+
+    // Reads must never block, we drain whatever is there after every wakeup.
+    fcntl(pipes[0], F_SETFL, fcntl(pipes[0], F_GETFL) | O_NONBLOCK);
+
+    tracees = realloc(tracees, (tracee_count + 1) * sizeof(struct tracee));
+    polled = realloc(polled, (tracee_count + 2) * sizeof(struct pollfd));
+    if (tracees == NULL || polled == NULL) {
+        perror("strace: could not allocate tracee information");
+        return -1;
+    }
+
+    struct tracee *new = &tracees[tracee_count];
+    new->pid = pid;
+    new->fd = pipes[0];
+    new->done = false;
+    new->is_child = is_child;
+    new->has_status = false;
+    new->buffered = 0;
+    polled[tracee_count + 1].fd = pipes[0];
+    polled[tracee_count + 1].events = POLLIN;
+    polled[tracee_count + 1].revents = 0;
+    tracee_count++;
+    return 0;
+}
+
+static struct thread_info *get_thread(uint16_t tid) {
+    for (int i = 0; i < thread_count; i++) {
+        if (infos[i].tid == tid) {
+            return &infos[i];
+        }
+    }
+
+    infos = realloc(infos, (++thread_count) * sizeof(struct thread_info));
+    if (infos == NULL) {
+        perror("strace: could not allocate thread information");
+        exit(1);
+    }
+    infos[thread_count - 1].tid = tid;
+    infos[thread_count - 1].is_syscall = true;
+    return &infos[thread_count - 1];
+}
+
+static void handle_record(int t, struct trace_record *rec, uint64_t now) {
+    struct thread_info *info = get_thread(rec->tid);
+    struct registers state = rec->state;
+    struct trace_event event = {
+        .pid   = tracees[t].pid,
+        .tid   = rec->tid,
+        .time  = now,
+        .state = state
+    };
+
+    if (info->is_syscall == true) {
+        event.kind = EVENT_ENTRY;
+        if (mode == MODE_FUTEX && state.rax == SYSCALL_FUTEX) {
+            futex_peek(&event);
+        }
+        push_event(&event);
+        info->syscall = state.rax;
+        info->arg = state.rdi;
+        info->is_syscall = state.rax == SYSCALL_EXIT ||
+                           state.rax == SYSCALL_EXIT_THREAD ||
+                           state.rax == SYSCALL_EXEC;
+
+        // exit does not come back, and it is the last record of the process,
+        // it is also the only way to know the exit code of non-children.
+        if (state.rax == SYSCALL_EXIT && !tracees[t].is_child) {
+            tracees[t].status = state.rdi;
+            tracees[t].has_status = true;
+        }
+    } else {
+        event.kind = EVENT_EXIT;
+        event.syscall = info->syscall;
+        // pipe returns its descriptors in the array passed to it.
+        if (mode == MODE_IO && info->syscall == SYSCALL_PIPE && state.rdx == 0) {
+            event.peeked.pipe.unreadable = read_tracee(event.pid, info->arg,
+                                                       event.peeked.pipe.fds,
+                                                       sizeof(event.peeked.pipe.fds));
+        }
+        push_event(&event);
+        info->is_syscall = true;
+
+        // A successful clone or spawn returns the PID of the new process to
+        // the parent, attach to it. exec keeps the PID, so tracing just
+        // carries on.
+        if (follow_children && state.rdx == 0 && state.rax != 0 &&
+            (info->syscall == SYSCALL_CLONE || info->syscall == SYSCALL_SPAWN)) {
+            attach_tracee(state.rax, false);
+        }
+    }
+}
+
+// Read and queue everything available in a pipe, returns true on EOF.
+static bool drain_tracee(int t) {
+    for (;;) {
+        struct tracee *tr = &tracees[t];
+        ssize_t count = read(tr->fd, tr->buffer + tr->buffered,
+                             sizeof(tr->buffer) - tr->buffered);
+        if (count == 0) {
+            return true;
+        } else if (count < 0) {
+            return errno != EAGAIN && errno != EINTR;
+        }
+
+        // Records are stamped when read, so latencies are as seen by us.
+        uint64_t now = 0;
+        if (need_timestamps) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            now = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+        }
+
+        tr->buffered += count;
+        size_t offset = 0;
+        while (tr->buffered - offset >= sizeof(struct trace_record)) {
+            struct trace_record rec;
+            memcpy(&rec, tr->buffer + offset, sizeof(rec));
+            offset += sizeof(rec);
+
+            // Records can attach new tracees, which moves the array around.
+            handle_record(t, &rec, now);
+            tr = &tracees[t];
+        }
+        memmove(tr->buffer, tr->buffer + offset, tr->buffered - offset);
+        tr->buffered -= offset;
+    }
+}
+
+static void finish_tracee(int t) {
+    struct tracee *tr = &tracees[t];
+    if (tr->done) {
+        return;
+    }
+
+    struct trace_event event = {.pid = tr->pid};
+    if (!tr->has_status) {
+        event.kind = EVENT_DETACHED;
+    } else if (!tr->is_child) {
+        event.kind = EVENT_EXITED;
+        event.status = tr->status;
+    } else if (WIFSIGNALED(tr->status)) {
+        event.kind = EVENT_KILLED;
+        event.status = WTERMSIG(tr->status);
+    } else {
+        event.kind = EVENT_EXITED;
+        event.status = WEXITSTATUS(tr->status);
+    }
+    push_event(&event);
+
+    close(tr->fd);
+    tr->done = true;
+    polled[t + 1].fd = -1;
+}
+
+// Reap our children, flushing whatever their pipes still hold before
+// reporting the exit, so the capture is complete.
+static void reap_children(void) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (int t = 0; t < tracee_count; t++) {
+            if (tracees[t].pid == pid && tracees[t].is_child && !tracees[t].done) {
+                tracees[t].status = status;
+                tracees[t].has_status = true;
+                drain_tracee(t);
+                finish_tracee(t);
+                break;
+            }
+        }
+    }
+}
+
+static void handle_signals(void) {
+    char signals[32];
+    ssize_t count;
+    bool do_reap = false;
+    while ((count = read(signal_pipe[0], signals, sizeof(signals))) > 0) {
+        for (ssize_t i = 0; i < count; i++) {
+            if (signals[i] == SIGCHLD) {
+                do_reap = true;
+            } else if (signals[i] == SIGUSR1) {
+                struct trace_event event = {.kind = EVENT_DUMP};
+                push_event(&event);
+            }
+        }
+    }
+    if (do_reap) {
+        reap_children();
+    }
+}
+
+static int64_t syscall_by_name(const char *name) {
+    char *end;
+    long number = strtol(name, &end, 10);
+    if (*name != '\0' && *end == '\0') {
+        return number;
+    }
+    for (int i = 0; i <= MAX_SYSCALL_IDX; i++) {
+        if (syscalls[i].name != NULL && !strcmp(syscalls[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool all_done(void) {
+    for (int t = 0; t < tracee_count; t++) {
+        if (!tracees[t].done) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int main(int argc, char *argv[]) {
-    FILE *out = stderr;
+    out = stderr;
+
+    static const struct option long_options[] = {
+        {"version", no_argument,       NULL, 'v'},
+        {"ring",    required_argument, NULL, 'R'},
+        {"trigger", required_argument, NULL, 'T'},
+        {"profile", optional_argument, NULL, 'P'},
+        {"io",      no_argument,       NULL, 'I'},
+        {"futex",   optional_argument, NULL, 'F'},
+        {"mmap",    optional_argument, NULL, 'M'},
+        {NULL,      0,                 NULL, 0}
+    };
 
     int c;
-    while ((c = getopt(argc, argv, "hvo:")) != -1) {
+    while ((c = getopt_long(argc, argv, "hvfo:", long_options, NULL)) != -1) {
         switch (c) {
             case 'h':
                 puts("Usage: strace [options] [command]");
@@ -233,6 +1618,18 @@ int main(int argc, char *argv[]) {
                 puts("-v|--version  Print version information");
                 puts("-r            Print raw info instead of pretty output");
                 puts("-o            Output file, else, stderr");
+                puts("-f            Follow the processes spawned by the tracee");
+                puts("--ring=<n>    Print nothing, keep the last n events of every");
+                puts("              thread and dump them on SIGUSR1 or abnormal exit");
+                puts("--trigger=<s> With --ring, also dump when syscall s fails");
+                puts("--profile[=n] Print nothing, report the n (30) call sites with");
+                puts("              the most time spent in syscalls at exit");
+                puts("--io          Print nothing, report I/O volume and sizes by");
+                puts("              file descriptor and thread at exit");
+                puts("--futex[=n]   Print nothing, report the n (20) futexes with the");
+                puts("              most time waited on, and their call sites, at exit");
+                puts("--mmap[=ms]   Print nothing, report mapping churn at exit, counting");
+                puts("              as short-lived mappings gone in under ms (10)");
                 puts("");
                 puts("Command:");
                 puts("Command that will be run for tracing");
@@ -244,6 +1641,55 @@ int main(int argc, char *argv[]) {
                     return 1;
                 }
                 break;
+            case 'f':
+                follow_children = true;
+                break;
+            case 'R':
+                mode = MODE_RING;
+                if (sscanf(optarg, "%zu", &recorder_size) != 1 || recorder_size == 0) {
+                    fprintf(stderr, "strace: '%s' is not a valid ring size\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'P':
+                mode = MODE_PROFILE;
+                need_timestamps = true;
+                if (optarg != NULL && (sscanf(optarg, "%zu", &profile_shown) != 1 ||
+                    profile_shown == 0)) {
+                    fprintf(stderr, "strace: '%s' is not a valid site count\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'I':
+                mode = MODE_IO;
+                break;
+            case 'F':
+                mode = MODE_FUTEX;
+                need_timestamps = true;
+                if (optarg != NULL && (sscanf(optarg, "%zu", &futex_shown) != 1 ||
+                    futex_shown == 0)) {
+                    fprintf(stderr, "strace: '%s' is not a valid futex count\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'M':
+                mode = MODE_MMAP;
+                need_timestamps = true;
+                if (optarg != NULL) {
+                    if (sscanf(optarg, "%lu", &mmap_short_ns) != 1) {
+                        fprintf(stderr, "strace: '%s' is not a valid time\n", optarg);
+                        return 1;
+                    }
+                    mmap_short_ns *= 1000000;
+                }
+                break;
+            case 'T':
+                recorder_trigger = syscall_by_name(optarg);
+                if (recorder_trigger == -1) {
+                    fprintf(stderr, "strace: '%s' is not a known syscall\n", optarg);
+                    return 1;
+                }
+                break;
             case 'v':
                puts("strace" VERSION_STR);
                return 0;
@@ -259,11 +1705,43 @@ int main(int argc, char *argv[]) {
     }
 
 END_WHILE:
-    int pipes[2];
-    if (pipe(pipes)) {
+    if (recorder_trigger != -1 && mode != MODE_RING) {
+        fprintf(stderr, "strace: --trigger only works with --ring\n");
+        return 1;
+    }
+
+    // Set up the signal self-pipe before the child exists, so that its exit
+    // cannot be missed, and have it be the first thing in the poll set.
+    if (pipe(signal_pipe)) {
         perror("strace: Could not create pipes");
         return 1;
     }
+    fcntl(signal_pipe[0], F_SETFL, fcntl(signal_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(signal_pipe[1], F_SETFL, fcntl(signal_pipe[1], F_GETFL) | O_NONBLOCK);
+    polled = malloc(sizeof(struct pollfd));
+    if (polled == NULL) {
+        perror("strace: could not allocate tracee information");
+        return 1;
+    }
+    polled[0].fd = signal_pipe[0];
+    polled[0].events = POLLIN;
+    polled[0].revents = 0;
+
+    struct sigaction action = {0};
+    action.sa_handler = signal_handler;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGCHLD, &action, NULL) ||
+        (mode == MODE_RING && sigaction(SIGUSR1, &action, NULL))) {
+        perror("strace: Could not set up signal handling");
+        return 1;
+    }
+
+    if (optind == argc) {
+        fputs("strace: no command specified\n", stderr);
+        return 1;
+    }
+    executable_path = execpath_find(argv[optind]);
 
     pid_t child = fork();
     if (child == 0) {
@@ -273,75 +1751,65 @@ END_WHILE:
         }
     }
 
-    int ret, errno, status;
-    uint16_t thread_id;
-    struct registers state;
-
-    SYSCALL4(SYSCALL_PTRACE, 1, child, 0, pipes[1]);
-    if (ret) {
-        fprintf(stderr, "strace: Could not do ptrace: %s\n", strerror(errno));
+    if (attach_tracee(child, true)) {
         return 1;
     }
 
-    // Poll for data to translate and print.
-    close(pipes[1]);
-    struct pollfd polled = {
-        .fd      = pipes[0],
-        .events  = POLLIN,
-        .revents = 0
-    };
+    // Have the writer batch its output in big chunks.
+    setvbuf(out, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+    pthread_t writer;
+    if (pthread_create(&writer, NULL, writer_main, NULL)) {
+        fputs("strace: Could not create the writer thread\n", stderr);
+        return 1;
+    }
 
-    // We keep an array as well for each thread we find in order to know how
-    // to continue syscalls without being nonsensical.
-    int thread_count = 0;
-    struct thread_info *infos = NULL;
+    // The child may have exited before the handler was of any use to us.
+    reap_children();
 
-    while (true) {
-        ret = poll(&polled, 1, -1);
+    while (!all_done()) {
+        int ret = poll(polled, tracee_count + 1, -1);
         if (ret == -1) {
+           if (errno == EINTR) {
+               continue;
+           }
            perror("strace: Could not poll");
            return 1;
         }
-        if (polled.revents & POLLIN) {
-           read(pipes[0], &thread_id, sizeof(uint16_t));
-           read(pipes[0], &state, sizeof(state));
-
-         PRINTER:
-           int found_idx = 0;
-           for (int i = 0; i < thread_count; i++) {
-               if (infos[i].tid == thread_id) {
-                   if (infos[i].is_syscall == true) {
-                       fprintf(out, "%d: ", thread_id);
-                       print_syscall(out, state);
-                       fprintf(out, "\n");
-                       infos[i].is_syscall = state.rax == SYSCALL_EXIT ||
-                                    state.rax == SYSCALL_EXIT_THREAD ||
-                                    state.rax == SYSCALL_EXEC;
-                   } else {
-                       fprintf(out, "\t%d: ", thread_id);
-                       print_error(out, state);
-                       fprintf(out, "\n");
-                       infos[i].is_syscall = true;
-                   }
-                   found_idx = 1;
-               }
-           }
-           if (!found_idx) {
-               infos = realloc(infos, (++thread_count) * sizeof(struct thread_info));
-               if (infos == NULL) {
-                   perror("strace: could not allocate thread information");
-                   return 1;
-               }
-               infos[thread_count - 1].tid = thread_id;
-               infos[thread_count - 1].is_syscall = true;
-               goto PRINTER;
-           }
+
+        // Children are added at the end of the poll set while we iterate it,
+        // they will be polled starting the next round.
+        int polled_count = tracee_count;
+        for (int t = 0; t < polled_count; t++) {
+            if (tracees[t].done) {
+                continue;
+            }
+            if (polled[t + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                bool eof = drain_tracee(t);
+
+                // Past an exit there is nothing else coming from a
+                // non-child, our children are reported once reaped.
+                if (!tracees[t].is_child && (eof || tracees[t].has_status)) {
+                    finish_tracee(t);
+                } else if (eof) {
+                    polled[t + 1].fd = -1;
+                }
+            }
         }
-        if (waitpid(child, &status, WNOHANG) == child) {
-            break;
+        if (polled[0].revents & POLLIN) {
+            handle_signals();
         }
+        ring_wake();
     }
 
-    fprintf(out, "+++ exited with %d +++\n", WEXITSTATUS(status));
+    atomic_store(&reader_done, true);
+    pthread_mutex_lock(&writer_lock);
+    pthread_cond_signal(&writer_cond);
+    pthread_mutex_unlock(&writer_lock);
+    pthread_join(writer, NULL);
+
+    unsigned long drops = atomic_load(&dropped_events);
+    if (drops != 0) {
+        fprintf(stderr, "strace: %lu events dropped, output could not keep up\n", drops);
+    }
     return 0;
 }
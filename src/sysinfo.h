@@ -0,0 +1,271 @@
+/*
+    sysinfo.h: Kernel queries and their formatting, shared between tools.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <sys/shm.h>
+#include <sys/mount.h>
+#include <sys/syscall.h>
+
+struct mem_info {
+    // All data is in bytes.
+    uint64_t phys_total;     // Total physical memory of the system.
+    uint64_t phys_available; // Non-reserved memory managed by the system.
+    uint64_t phys_free;      // Free memory available to the system.
+    uint64_t shared_usage;   // Amount of shared memory in the system.
+    uint64_t kernel_usage;   // Amount of memory in use by the kernel.
+    uint64_t table_usage;    // Of the kernel, amount in use for page tables.
+    uint64_t poison_usage;   // Faulty memory.
+};
+
+struct cpuinfo {
+    uint64_t conf_cores;
+    uint64_t onln_cores;
+    char model_name[64];
+    char vendor_name[64];
+    uint32_t base_mhz;
+    uint32_t max_mhz;
+    uint32_t ref_mhz;
+};
+
+#define PROC_IS_TRACED  0b01
+#define PROC_EXITED     0b10
+
+struct procinfo {
+    char     id[20];
+    uint16_t id_len;
+    uint16_t ppid;
+    uint16_t pid;
+    uint32_t uid;
+    uint32_t flags;
+    struct timespec elapsed;
+} __attribute__((packed));
+
+struct threadinfo {
+    uint16_t tid;
+    int16_t  niceness;
+    uint16_t tcid;
+    uint16_t pid;
+} __attribute__((packed));
+
+struct tclusterinfo {
+    uint16_t tcid;
+    uint16_t tcflags;
+    uint16_t tcquantum;
+} __attribute__((packed));
+
+struct mountinfo {
+    uint32_t type;
+    uint32_t flags;
+    char     source[20];
+    uint32_t source_length;
+    char     location[20];
+    uint32_t location_length;
+    uint64_t blocksize;
+    uint64_t fragsize;
+    uint64_t sizeinfrags;
+    uint64_t freeblocks;
+    uint64_t freeblocksu;
+    uint64_t inodecount;
+    uint64_t freeinodes;
+    uint64_t freebinodesu;
+    uint64_t maxfile;
+};
+
+#define NETINTER_BLOCKED 0b1
+
+struct netinterface {
+    char devname[65];
+    uint64_t flags;
+    uint8_t mac_addr[6];
+    uint8_t ipv4_addr[4];
+    uint8_t ipv4_subnet[4];
+    uint8_t ipv6_addr[16];
+    uint8_t ipv6_subnet[16];
+} __attribute__((packed));
+
+#define FLOCK_MODE_WRITE 0b1
+
+struct flockinfo {
+    uint32_t pid;
+    uint32_t mode;
+    uint64_t start;
+    uint64_t length;
+    uint64_t fs;
+    uint64_t ino;
+} __attribute__((packed));
+
+// Buffers for the listing queries, kept around and grown as needed so that
+// tools taking repeated snapshots do not allocate every time.
+struct sysinfo_list {
+    void  *items;
+    size_t capacity;
+    size_t count;
+};
+
+// Run one of the listing syscalls, which take a buffer and its length in
+// items and return how many items there are. A full buffer may mean that
+// some did not fit, so it is grown and the query retried. Returns 0 on
+// success.
+static inline int sysinfo_fetch(struct sysinfo_list *list, long syscall_num,
+                                size_t item_size) {
+    if (list->capacity == 0) {
+        list->capacity = 16;
+        list->items = malloc(list->capacity * item_size);
+        if (list->items == NULL) {
+            list->capacity = 0;
+            return -1;
+        }
+    }
+
+    for (;;) {
+        long ret, errno;
+        SYSCALL2(syscall_num, list->items, list->capacity);
+        if (ret == -1) {
+            return -1;
+        } else if ((size_t)ret < list->capacity) {
+            list->count = ret;
+            return 0;
+        }
+
+        size_t new_capacity = (size_t)ret > list->capacity * 2 ? (size_t)ret + 1 :
+                                                                  list->capacity * 2;
+        void *grown = realloc(list->items, new_capacity * item_size);
+        if (grown == NULL) {
+            return -1;
+        }
+        list->items = grown;
+        list->capacity = new_capacity;
+    }
+}
+
+static inline void sysinfo_list_free(struct sysinfo_list *list) {
+    free(list->items);
+    list->items = NULL;
+    list->capacity = 0;
+    list->count = 0;
+}
+
+static inline int sysinfo_meminfo(struct mem_info *info) {
+    long ret, errno;
+    SYSCALL1(SYSCALL_MEMINFO, info);
+    return ret == 0 ? 0 : -1;
+}
+
+static inline int sysinfo_cpuinfo(struct cpuinfo *info) {
+    long ret, errno;
+    SYSCALL1(SYSCALL_GETCPUINFO, info);
+    return ret == 0 ? 0 : -1;
+}
+
+static inline void sysinfo_print_meminfo(FILE *out, const struct mem_info *meminfo) {
+    // Translate all values to kilobytes.
+    const long free       = meminfo->phys_free      / 1000;
+    const long available  = meminfo->phys_available / 1000;
+    const long total      = meminfo->phys_total     / 1000;
+    const int width = round(1 + log(total) / log(10));
+
+    fprintf(out, "Free memory:      %*lu kB\n", width, free);
+    fprintf(out, "Used memory:      %*lu kB\n", width, available - free);
+    fprintf(out, "Available memory: %*lu kB\n", width, available);
+    fprintf(out, "Total memory:     %*lu kB\n", width, total);
+    fprintf(out, "Shared memory:    %*lu kB\n", width, meminfo->shared_usage / 1000);
+    fprintf(out, "Kernel memory:    %*lu kB\n", width, meminfo->kernel_usage / 1000);
+    fprintf(out, "Table memory:     %*lu kB\n", width, meminfo->table_usage  / 1000);
+    fprintf(out, "Poisoned memory:  %*lu kB\n", width, meminfo->poison_usage / 1000);
+}
+
+static inline void sysinfo_print_process_header(FILE *out) {
+    fprintf(out, "%4s %4s %11s %20s\n", "PPID", "PID", "STAT", "CMD");
+}
+
+static inline void sysinfo_print_process(FILE *out, const struct procinfo *proc) {
+    char flags_message[] = "xxx-xxx";
+    if (proc->flags & PROC_IS_TRACED) {
+        flags_message[0] = 't';
+        flags_message[1] = 'r';
+        flags_message[2] = 'a';
+    }
+    if (proc->flags & PROC_EXITED) {
+        flags_message[4] = 'e';
+        flags_message[5] = 'x';
+        flags_message[6] = 'd';
+    }
+    fprintf(out, "%4d %4d %11s %20.*s\n", proc->ppid, proc->pid, flags_message,
+        proc->id_len, proc->id);
+}
+
+static inline const char *sysinfo_mount_type(int type) {
+   switch (type) {
+      case MNT_EXT: return "ext";
+      case MNT_FAT: return "fat";
+      case MNT_DEV: return "devfs";
+      default: return NULL;
+   }
+}
+
+static inline void sysinfo_print_mounts(FILE *out, const struct sysinfo_list *mounts) {
+    const struct mountinfo *buffer = mounts->items;
+    for (size_t i = 0; i < mounts->count; i++) {
+        fprintf(out, "%.*s ", buffer[i].source_length, buffer[i].source);
+        fprintf(out, "%.*s ", buffer[i].location_length, buffer[i].location);
+        fprintf(out, "type %s (", sysinfo_mount_type(buffer[i].type));
+        if (buffer[i].flags & MS_RDONLY) {
+            fprintf(out, "ro");
+        } else {
+            fprintf(out, "rw");
+        }
+        if (buffer[i].flags & MS_RELATIME) {
+            fprintf(out, ",relatime");
+        }
+        fprintf(out, ")\n");
+    }
+}
+
+static inline void sysinfo_print_shm(FILE *out) {
+    // In Ironclad, shmids go from 1 to X, where X is 20 for current releases.
+    // So we can just iterate that.
+    struct shmid_ds buf;
+    fputs("Shared Memory Segments:\n", out);
+    fprintf(out, "%10s %5s %10s %10s %10s %6s\n", "key", "shmid", "owner", "perms",
+        "bytes", "nattach");
+    for (int i = 1; i <= 20; i++) {
+        if (!shmctl(i, IPC_STAT, &buf)) {
+            fprintf(out, "%010d %5d %10d %10o %10zu %6ld\n", buf.shm_perm.__ipc_perm_key,
+                i, buf.shm_perm.uid, buf.shm_perm.mode, buf.shm_segsz,
+                buf.shm_nattch);
+        }
+    }
+}
+
+static inline void sysinfo_print_flocks(FILE *out, const struct sysinfo_list *flocks) {
+    const struct flockinfo *buffer = flocks->items;
+    fputs("POSIX filelocks:\n", out);
+    fprintf(out, "%4s %4s %20s %20s %10s %10s\n", "PID", "MODE", "START", "LENGTH", "FS", "INO");
+    for (size_t i = 0; i < flocks->count; i++) {
+        fprintf(out, "%4" PRIu32 " %4s %20" PRIu64 " %20" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+                buffer[i].pid, buffer[i].mode == FLOCK_MODE_WRITE ? "W" : "R",
+                buffer[i].start, buffer[i].length, buffer[i].fs, buffer[i].ino);
+    }
+}
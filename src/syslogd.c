@@ -0,0 +1,236 @@
+/*
+    syslogd.c: Store the messages sent to the local syslog socket.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <commons.h>
+#include <logstore.h>
+
+#define DEFAULT_SOCKET_PATH "/dev/log"
+#define DEFAULT_PRIORITY (LOG_USER | LOG_NOTICE)
+#define DEFAULT_SOCKET_MODE 0666
+
+static volatile sig_atomic_t should_exit = 0;
+
+static void signal_handler(int sig) {
+    (void)sig;
+    should_exit = 1;
+}
+
+// Messages come as "<priority>timestamp tag[pid]: message", with everything
+// but the message being optional. The timestamp is dropped, we use the time
+// of reception instead.
+static void store_message(struct logstore *store, char *msg, size_t len, int64_t now) {
+    size_t i = 0;
+    int priority = DEFAULT_PRIORITY;
+    if (len > 0 && msg[0] == '<') {
+        int value = 0;
+        for (i = 1; i < len && i < 5 && msg[i] >= '0' && msg[i] <= '9'; i++) {
+            value = value * 10 + (msg[i] - '0');
+        }
+        if (i < len && msg[i] == '>' && value <= (LOG_LOCAL7 | LOG_DEBUG)) {
+            priority = value;
+            i++;
+        } else {
+            i = 0;
+        }
+    }
+
+    if (len - i >= 16 && msg[i + 3] == ' ' && msg[i + 6] == ' ' &&
+        msg[i + 9] == ':' && msg[i + 12] == ':' && msg[i + 15] == ' ') {
+        i += 16;
+    }
+
+    size_t tag_start = i, tag_end = i, j = i;
+    while (j < len && msg[j] != ':' && msg[j] != '[' && msg[j] != ' ') {
+        j++;
+    }
+    tag_end = j;
+    if (j < len && msg[j] == '[') {
+        while (j < len && msg[j] != ']') {
+            j++;
+        }
+        j++;
+    }
+    if (j < len && msg[j] == ':') {
+        i = j + 1;
+        if (i < len && msg[i] == ' ') {
+            i++;
+        }
+    } else {
+        tag_end = tag_start;
+    }
+
+    while (len > i && msg[len - 1] == '\n') {
+        len--;
+    }
+    logstore_append(store, now, priority, msg + tag_start, tag_end - tag_start,
+                    msg + i, len - i);
+}
+
+int main(int argc, char *argv[]) {
+    const char *store_path = LOGSTORE_DEFAULT_PATH;
+    const char *socket_path = DEFAULT_SOCKET_PATH;
+    long segment_size = LOGSTORE_DEFAULT_SEGMENT_SIZE;
+    long segment_count = LOGSTORE_DEFAULT_SEGMENTS;
+    mode_t socket_mode = DEFAULT_SOCKET_MODE;
+    bool foreground = false;
+
+    char c;
+    while ((c = getopt(argc, argv, "hvfo:S:m:s:n:")) != -1) {
+        switch (c) {
+            case 'h':
+                puts("Usage: syslogd [options]");
+                puts("");
+                puts("Options:");
+                puts("-h              Print this help message");
+                puts("-v              Display version information.");
+                puts("-f              Stay in the foreground");
+                puts("-o <path>       Store messages at path, " LOGSTORE_DEFAULT_PATH " by default");
+                puts("-S <path>       Listen on socket path, " DEFAULT_SOCKET_PATH " by default");
+                puts("-m <mode>       Octal mode of the socket, 0666 by default so that");
+                puts("                every user can log");
+                puts("-s <KiB>        Size of every segment of the store");
+                puts("-n <count>      Number of segments of the store");
+                return 0;
+            case 'v':
+                puts("syslogd" VERSION_STR);
+                return 0;
+            case 'f':
+                foreground = true;
+                break;
+            case 'o':
+                store_path = optarg;
+                break;
+            case 'S':
+                socket_path = optarg;
+                break;
+            case 'm': {
+                char *end;
+                long mode = strtol(optarg, &end, 8);
+                if (*optarg == '\0' || *end != '\0' || mode < 0 || mode > 0777) {
+                    fprintf(stderr, "syslogd: '%s' is not a valid mode\n", optarg);
+                    return 1;
+                }
+                socket_mode = mode;
+                break;
+            }
+            case 's': {
+                char *end;
+                long kib = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || kib <= 0 || kib > UINT32_MAX / 2 / 1024) {
+                    fprintf(stderr, "syslogd: '%s' is not a valid segment size\n", optarg);
+                    return 1;
+                }
+                segment_size = kib * 1024;
+                break;
+            }
+            case 'n': {
+                char *end;
+                segment_count = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || segment_count <= 0 ||
+                    segment_count > 4096) {
+                    fprintf(stderr, "syslogd: '%s' is not a valid segment count\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            default:
+                fprintf(stderr, "syslogd: %c is not a valid argument\n", optopt);
+                return 1;
+        }
+    }
+
+    struct logstore store;
+    if (logstore_create(&store, store_path, segment_size, segment_count)) {
+        if (errno == EEXIST) {
+            fprintf(stderr, "syslogd: %s has a different geometry, remove it or pass "
+                            "the -s and -n it was created with\n", store_path);
+        } else if (errno == EINVAL) {
+            fprintf(stderr, "syslogd: %s is not a log store\n", store_path);
+        } else {
+            perror("syslogd: Could not create the log store");
+        }
+        return 1;
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "syslogd: Socket path is too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (sock == -1) {
+        perror("syslogd: Could not create socket");
+        return 1;
+    }
+    unlink(socket_path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        perror("syslogd: Could not bind socket");
+        return 1;
+    }
+    if (chmod(socket_path, socket_mode)) {
+        perror("syslogd: Could not set the socket mode");
+        return 1;
+    }
+
+    if (!foreground && daemon(0, 0)) {
+        perror("syslogd: Could not daemonize");
+        return 1;
+    }
+
+    // No SA_RESTART, so that recv is interrupted and we can flush on exit.
+    struct sigaction action = {0};
+    action.sa_handler = signal_handler;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+
+    // Messages are appended straight from the receive buffer, nothing is
+    // allocated or synced per message, the kernel writes the pages back.
+    static char buffer[LOGSTORE_MAX_TAG + LOGSTORE_MAX_MESSAGE + 64];
+    while (!should_exit) {
+        ssize_t len = recv(sock, buffer, sizeof(buffer), 0);
+        if (len <= 0) {
+            continue;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        store_message(&store, buffer, len, now.tv_sec * 1000000000LL + now.tv_nsec);
+    }
+
+    msync(store.map, store.map_size, MS_SYNC);
+    logstore_close(&store);
+    close(sock);
+    unlink(socket_path);
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+    sysstat.h: Shared memory snapshots of system state published by sysstatd.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/shm.h>
+#include <sysinfo.h>
+
+// sysstatd takes the snapshots every interval and writes them to a SysV
+// shared memory segment under a sequence lock: the sequence is odd while
+// the snapshot is being written, and readers retry whenever it was odd or
+// changed during their copy. Snapshots older than twice the interval are
+// taken to mean sysstatd is gone, and clients fall back to the syscalls.
+#define SYSSTAT_KEY 0x53595354
+#define SYSSTAT_MAGIC 0x3154415453535953ULL
+#define SYSSTAT_MAX_PROCS 1024
+#define SYSSTAT_MAX_MOUNTS 64
+#define SYSSTAT_MAX_NETINTERS 32
+#define SYSSTAT_READ_RETRIES 16
+
+// Anybody can create a segment with the key first, so it is only trusted
+// when it belongs to the user sysstatd runs as and nobody else can write it.
+#ifndef SYSSTAT_OWNER_UID
+#define SYSSTAT_OWNER_UID 0
+#endif
+
+struct sysstat_segment {
+    uint64_t magic;
+    _Atomic uint64_t seq;
+    int64_t updated_ns;
+    uint32_t interval_ms;
+    uint32_t proc_count;
+    uint32_t mount_count;
+    uint32_t netinter_count;
+    struct mem_info meminfo;
+    struct procinfo procs[SYSSTAT_MAX_PROCS];
+    struct mountinfo mounts[SYSSTAT_MAX_MOUNTS];
+    struct netinterface netinters[SYSSTAT_MAX_NETINTERS];
+};
+
+static inline int64_t sysstat_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Writer side, called by sysstatd around its updates of the segment.
+static inline void sysstat_write_begin(struct sysstat_segment *seg) {
+    atomic_fetch_add_explicit(&seg->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void sysstat_write_end(struct sysstat_segment *seg) {
+    atomic_fetch_add_explicit(&seg->seq, 1, memory_order_release);
+}
+
+static inline bool sysstat_trusted(int id, uid_t owner) {
+    struct shmid_ds ds;
+    if (shmctl(id, IPC_STAT, &ds)) {
+        return false;
+    }
+    return ds.shm_perm.cuid == owner && ds.shm_perm.uid == owner &&
+           !(ds.shm_perm.mode & 0022) && ds.shm_segsz >= sizeof(struct sysstat_segment);
+}
+
+// Attach to the segment of sysstatd, NULL if there is none or it is not
+// trusted. The mapping is kept for the lifetime of the process.
+static inline const struct sysstat_segment *sysstat_attach(void) {
+    static const struct sysstat_segment *seg = NULL;
+    static bool tried = false;
+    if (!tried) {
+        tried = true;
+        int id = shmget(SYSSTAT_KEY, sizeof(struct sysstat_segment), 0);
+        if (id != -1 && sysstat_trusted(id, SYSSTAT_OWNER_UID)) {
+            void *addr = shmat(id, NULL, SHM_RDONLY);
+            if (addr != (void *)-1) {
+                seg = addr;
+            }
+        }
+    }
+    if (seg == NULL || seg->magic != SYSSTAT_MAGIC) {
+        return NULL;
+    }
+    return seg;
+}
+
+// Copy a consistent snapshot of a count and the array it sizes, returns
+// the count, or -1 if the snapshot is stale, did not fit in the segment,
+// or kept changing under us.
+static inline long sysstat_copy(const struct sysstat_segment *seg, const uint32_t *count,
+                                const void *items, size_t item_size, size_t max_items,
+                                void *dest) {
+    for (int i = 0; i < SYSSTAT_READ_RETRIES; i++) {
+        uint64_t start = atomic_load_explicit(&seg->seq, memory_order_acquire);
+        if (start & 1) {
+            continue;
+        }
+
+        int64_t age = sysstat_now_ns() - seg->updated_ns;
+        if (age > 2 * (int64_t)seg->interval_ms * 1000000) {
+            return -1;
+        }
+        size_t n = *count;
+        if (n > max_items) {
+            return -1;
+        }
+        memcpy(dest, items, n * item_size);
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&seg->seq, memory_order_relaxed) == start) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+// Drop-in replacements for sysinfo_meminfo and sysinfo_fetch, reading from
+// the segment when it is fresh and asking the kernel otherwise.
+static inline int sysstat_meminfo(struct mem_info *info) {
+    const struct sysstat_segment *seg = sysstat_attach();
+    static const uint32_t one = 1;
+    if (seg != NULL &&
+        sysstat_copy(seg, &one, &seg->meminfo, sizeof(struct mem_info), 1, info) == 1) {
+        return 0;
+    }
+    return sysinfo_meminfo(info);
+}
+
+static inline int sysstat_fetch(struct sysinfo_list *list, long syscall_num,
+                                size_t item_size) {
+    const struct sysstat_segment *seg = sysstat_attach();
+    const uint32_t *count = NULL;
+    const void *items = NULL;
+    size_t max_items = 0;
+    if (seg != NULL && syscall_num == SYSCALL_LISTPROCS) {
+        count = &seg->proc_count;
+        items = seg->procs;
+        max_items = SYSSTAT_MAX_PROCS;
+    } else if (seg != NULL && syscall_num == SYSCALL_LISTMOUNTS) {
+        count = &seg->mount_count;
+        items = seg->mounts;
+        max_items = SYSSTAT_MAX_MOUNTS;
+    } else if (seg != NULL && syscall_num == SYSCALL_LISTNETINTER) {
+        count = &seg->netinter_count;
+        items = seg->netinters;
+        max_items = SYSSTAT_MAX_NETINTERS;
+    }
+
+    if (count != NULL) {
+        if (list->capacity < max_items) {
+            void *grown = realloc(list->items, max_items * item_size);
+            if (grown != NULL) {
+                list->items = grown;
+                list->capacity = max_items;
+            }
+        }
+        if (list->capacity >= max_items) {
+            long n = sysstat_copy(seg, count, items, item_size, max_items, list->items);
+            if (n != -1) {
+                list->count = n;
+                return 0;
+            }
+        }
+    }
+    return sysinfo_fetch(list, syscall_num, item_size);
+}
@@ -0,0 +1,181 @@
+/*
+    sysstatd.c: Publish snapshots of the system state in shared memory.
+    Copyright (C) 2026 streaksu
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <syslog.h>
+#include <sys/shm.h>
+#include <commons.h>
+#include <sysstat.h>
+
+#define DEFAULT_INTERVAL_MS 1000
+
+static volatile sig_atomic_t should_exit = 0;
+
+static void signal_handler(int sig) {
+    (void)sig;
+    should_exit = 1;
+}
+
+int main(int argc, char *argv[]) {
+    long interval = DEFAULT_INTERVAL_MS;
+    bool foreground = false;
+
+    char c;
+    while ((c = getopt(argc, argv, "hvfi:")) != -1) {
+        switch (c) {
+            case 'h':
+                puts("Usage: sysstatd [options]");
+                puts("");
+                puts("Options:");
+                puts("-h              Print this help message");
+                puts("-v              Display version information.");
+                puts("-f              Stay in the foreground");
+                puts("-i <ms>         Take a snapshot every ms milliseconds, 1000 by default");
+                return 0;
+            case 'v':
+                puts("sysstatd" VERSION_STR);
+                return 0;
+            case 'f':
+                foreground = true;
+                break;
+            case 'i': {
+                char *end;
+                interval = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || interval <= 0 ||
+                    interval > UINT32_MAX / 2) {
+                    fprintf(stderr, "sysstatd: '%s' is not a valid interval\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            default:
+                fprintf(stderr, "sysstatd: %c is not a valid argument\n", optopt);
+                return 1;
+        }
+    }
+
+    // A segment left by a previous run of ours is reused, as its readers may
+    // still be attached, anything else under the key is replaced.
+    int id = shmget(SYSSTAT_KEY, sizeof(struct sysstat_segment), IPC_CREAT | IPC_EXCL | 0644);
+    if (id == -1 && errno == EEXIST) {
+        id = shmget(SYSSTAT_KEY, 0, 0);
+        if (id != -1 && !sysstat_trusted(id, geteuid())) {
+            if (shmctl(id, IPC_RMID, NULL)) {
+                perror("sysstatd: Could not remove the existing shared memory segment");
+                return 1;
+            }
+            id = shmget(SYSSTAT_KEY, sizeof(struct sysstat_segment),
+                        IPC_CREAT | IPC_EXCL | 0644);
+        }
+    }
+    if (id == -1) {
+        perror("sysstatd: Could not create the shared memory segment");
+        return 1;
+    }
+    struct sysstat_segment *seg = shmat(id, NULL, 0);
+    if (seg == (void *)-1) {
+        perror("sysstatd: Could not attach the shared memory segment");
+        return 1;
+    }
+
+    if (!foreground && daemon(0, 0)) {
+        perror("sysstatd: Could not daemonize");
+        return 1;
+    }
+
+    openlog("sysstatd", LOG_NDELAY | LOG_PID, LOG_DAEMON);
+
+    struct sigaction action = {0};
+    action.sa_handler = signal_handler;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+
+    // The segment may be left over from a previous run, whose readers could
+    // still be attached, so take it over under the lock. A writer that died
+    // midway leaves the sequence odd, which would invert its meaning for us.
+    uint64_t seq = atomic_load_explicit(&seg->seq, memory_order_relaxed);
+    atomic_store_explicit(&seg->seq, (seq + 1) & ~1ULL, memory_order_release);
+    sysstat_write_begin(seg);
+    seg->interval_ms = interval;
+    seg->magic = SYSSTAT_MAGIC;
+    sysstat_write_end(seg);
+
+    // Everything is queried into our own buffers first, so that the segment
+    // is only locked for the copies and readers rarely have to retry.
+    struct sysinfo_list procs = {0}, mounts = {0}, netinters = {0};
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    while (!should_exit) {
+        struct mem_info meminfo;
+        bool ok = !sysinfo_meminfo(&meminfo) &&
+                  !sysinfo_fetch(&procs, SYSCALL_LISTPROCS, sizeof(struct procinfo)) &&
+                  !sysinfo_fetch(&mounts, SYSCALL_LISTMOUNTS, sizeof(struct mountinfo)) &&
+                  !sysinfo_fetch(&netinters, SYSCALL_LISTNETINTER, sizeof(struct netinterface));
+        if (ok) {
+            // Lists that do not fit are published with their real count
+            // and no items, which makes readers ask the kernel for them.
+            sysstat_write_begin(seg);
+            seg->meminfo = meminfo;
+            seg->proc_count = procs.count;
+            if (procs.count <= SYSSTAT_MAX_PROCS) {
+                memcpy(seg->procs, procs.items, procs.count * sizeof(struct procinfo));
+            }
+            seg->mount_count = mounts.count;
+            if (mounts.count <= SYSSTAT_MAX_MOUNTS) {
+                memcpy(seg->mounts, mounts.items, mounts.count * sizeof(struct mountinfo));
+            }
+            seg->netinter_count = netinters.count;
+            if (netinters.count <= SYSSTAT_MAX_NETINTERS) {
+                memcpy(seg->netinters, netinters.items,
+                       netinters.count * sizeof(struct netinterface));
+            }
+            seg->updated_ns = sysstat_now_ns();
+            sysstat_write_end(seg);
+        } else {
+            syslog(LOG_ERR, "Could not sample the system state");
+        }
+
+        deadline.tv_sec += interval / 1000;
+        deadline.tv_nsec += (interval % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+    }
+
+    // Clients attached to the segment fall back to the syscalls once the
+    // magic is gone, and it is freed when the last of them detaches.
+    sysstat_write_begin(seg);
+    seg->magic = 0;
+    sysstat_write_end(seg);
+    shmdt(seg);
+    shmctl(id, IPC_RMID, NULL);
+    sysinfo_list_free(&procs);
+    sysinfo_list_free(&mounts);
+    sysinfo_list_free(&netinters);
+    return 0;
+}
@@ -31,25 +31,539 @@
 #include <termios.h>
 #include <sys/ioctl.h>
 #include <sys/wait.h>
-#include <sys/syscall.h>
+#include <getopt.h>
+#include <errno.h>
+#include <signal.h>
+#include <sysinfo.h>
+#include <execpath.h>
+
+// Output is captured and drawn into a grid of cells, which is compared with
+// the one of the previous update so only the cells that changed are sent.
+#define DEFAULT_COLS 80
+#define DEFAULT_ROWS 24
+#define TAB_WIDTH 8
+
+struct capture {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+struct screen {
+    int rows;
+    int cols;
+    char *cells;
+    bool *marked;
+};
+
+static int read_capture(int fd, struct capture *out) {
+    out->len = 0;
+    for (;;) {
+        if (out->len == out->cap) {
+            size_t new_cap = out->cap ? out->cap * 2 : 4096;
+            char *grown = realloc(out->data, new_cap);
+            if (grown == NULL) {
+                return -1;
+            }
+            out->data = grown;
+            out->cap  = new_cap;
+        }
+
+        ssize_t count = read(fd, out->data + out->len, out->cap - out->len);
+        if (count == -1) {
+            return -1;
+        } else if (count == 0) {
+            return 0;
+        }
+        out->len += count;
+    }
+}
+
+// Spawn a program with its stdout and stderr on out_fd, and its stdin on
+// in_fd if not -1. Returns the pid, or -1 on failure.
+static int spawn_redirected(const char *path, char **args, size_t argc, char **envp,
+                            size_t envc, int in_fd, int out_fd) {
+    // The spawned program inherits our stdio, so point it at the pipes for
+    // the duration of the spawn.
+    fflush(stdout);
+    int saved_in  = in_fd != -1 ? fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 3) : -1;
+    int saved_out = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3);
+    int saved_err = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 3);
+    if (in_fd != -1) {
+        dup2(in_fd, STDIN_FILENO);
+    }
+    dup2(out_fd, STDOUT_FILENO);
+    dup2(out_fd, STDERR_FILENO);
+
+    int ret, errno;
+    SYSCALL7(SYSCALL_SPAWN, path, strlen(path), args, argc, (uint64_t)envp, envc, NULL);
+    int spawn_ret = ret, spawn_errno = errno;
+
+    if (saved_in != -1) {
+        dup2(saved_in, STDIN_FILENO);
+        close(saved_in);
+    }
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    close(saved_out);
+    close(saved_err);
+    return spawn_errno ? -1 : spawn_ret;
+}
+
+static int cloexec_pipe(int pipefd[2]) {
+    if (pipe(pipefd)) {
+        return -1;
+    }
+    fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+// Spawn a program and capture all it writes until it exits. Returns the
+// wait status, or -1 on failure.
+static int run_captured(const char *path, char **args, size_t argc, char **envp,
+                        size_t envc, struct capture *out) {
+    int pipefd[2];
+    if (cloexec_pipe(pipefd)) {
+        return -1;
+    }
+
+    int pid = spawn_redirected(path, args, argc, envp, envc, -1, pipefd[1]);
+    close(pipefd[1]);
+    if (pid == -1) {
+        close(pipefd[0]);
+        return -1;
+    }
+
+    int result = read_capture(pipefd[0], out);
+    close(pipefd[0]);
+
+    int wstatus;
+    if (waitpid(pid, &wstatus, 0) == -1 || result) {
+        return -1;
+    }
+    return wstatus;
+}
+
+// Commands that need the shell are run by one that is kept around, instead
+// of a new one per update. Every command runs in a subshell of it, so that
+// cd, variables, options and traps do not carry over between updates, and
+// is followed by printing a marker and its status, which tells where its
+// output ends.
+#define SHELL_MARKER "\x1fwatch-done "
+
+struct shell {
+    int pid;
+    int in_fd;
+    int out_fd;
+};
+
+static int shell_start(struct shell *sh, char **envp, size_t envc) {
+    int in_pipe[2], out_pipe[2];
+    if (cloexec_pipe(in_pipe)) {
+        return -1;
+    }
+    if (cloexec_pipe(out_pipe)) {
+        close(in_pipe[0]);
+        close(in_pipe[1]);
+        return -1;
+    }
+
+    char *args[] = {"sh", NULL};
+    sh->pid = spawn_redirected("/bin/sh", args, 1, envp, envc, in_pipe[0], out_pipe[1]);
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    sh->in_fd = in_pipe[1];
+    sh->out_fd = out_pipe[0];
+    if (sh->pid == -1) {
+        close(sh->in_fd);
+        close(sh->out_fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void shell_stop(struct shell *sh) {
+    close(sh->in_fd);
+    close(sh->out_fd);
+    waitpid(sh->pid, NULL, 0);
+    sh->pid = -1;
+}
+
+static bool write_all(int fd, const char *str, size_t len) {
+    while (len != 0) {
+        ssize_t count = write(fd, str, len);
+        if (count <= 0) {
+            return false;
+        }
+        str += count;
+        len -= count;
+    }
+    return true;
+}
+
+// Run a command on the shell and capture its output, returns a wait status
+// or -1 on failure. If the shell dies anyway, say killed by the command, the
+// status is the one of the shell, which is started again for the next run.
+static int shell_run(struct shell *sh, const char *script, struct capture *out) {
+    if (!write_all(sh->in_fd, script, strlen(script))) {
+        shell_stop(sh);
+        return -1;
+    }
+
+    size_t marker_len = strlen(SHELL_MARKER);
+    size_t searched = 0;
+    out->len = 0;
+    for (;;) {
+        if (out->cap - out->len < 4096) {
+            size_t new_cap = out->cap ? out->cap * 2 : 8192;
+            char *grown = realloc(out->data, new_cap);
+            if (grown == NULL) {
+                return -1;
+            }
+            out->data = grown;
+            out->cap  = new_cap;
+        }
+
+        ssize_t count = read(sh->out_fd, out->data + out->len, out->cap - out->len - 1);
+        if (count == -1) {
+            return -1;
+        } else if (count == 0) {
+            close(sh->in_fd);
+            close(sh->out_fd);
+            int wstatus;
+            if (waitpid(sh->pid, &wstatus, 0) == -1) {
+                wstatus = -1;
+            }
+            sh->pid = -1;
+            return wstatus;
+        }
+        out->len += count;
+        out->data[out->len] = '\0';
+
+        // Only look at what came in since the last read, plus enough before
+        // it for a marker split between reads.
+        size_t i = searched;
+        for (; i + marker_len <= out->len; i++) {
+            if (out->data[i] == SHELL_MARKER[0] &&
+                !memcmp(out->data + i, SHELL_MARKER, marker_len)) {
+                break;
+            }
+        }
+        if (i + marker_len > out->len) {
+            searched = out->len >= marker_len ? out->len - marker_len + 1 : 0;
+            continue;
+        }
+
+        // Wait for the whole status line before taking the marker.
+        searched = i;
+        if (memchr(out->data + i, '\n', out->len - i) != NULL) {
+            int status = atoi(out->data + i + marker_len);
+            out->len = i;
+            return (status & 0xff) << 8;
+        }
+    }
+}
+
+// Whether a command uses anything only the shell can handle, otherwise it
+// is split on blanks and run directly.
+static bool needs_shell(const char *cmd) {
+    if (strpbrk(cmd, "|&;<>()$`\\\"'*?[]#~{}!\n") != NULL) {
+        return true;
+    }
+    size_t first_word = strcspn(cmd, " \t");
+    return memchr(cmd, '=', first_word) != NULL;
+}
+
+// Outputs are compared by hash, so nothing but the last hash is kept.
+static uint64_t hash_output(const char *data, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+
+// --until looks for its pattern with a rolling hash over the output, only
+// comparing the bytes where the hash of the window matches the pattern's.
+#define ROLL_BASE 257
+
+struct rolling_pattern {
+    const char *str;
+    size_t len;
+    uint64_t hash;
+    uint64_t top;
+};
+
+static void build_pattern(struct rolling_pattern *pat, const char *str) {
+    pat->str = str;
+    pat->len = strlen(str);
+    pat->hash = 0;
+    pat->top = 1;
+    for (size_t i = 0; i < pat->len; i++) {
+        pat->hash = pat->hash * ROLL_BASE + (unsigned char)str[i];
+        if (i != 0) {
+            pat->top *= ROLL_BASE;
+        }
+    }
+}
+
+static bool output_contains(const struct rolling_pattern *pat, const char *data, size_t len) {
+    if (pat->len == 0) {
+        return true;
+    } else if (len < pat->len) {
+        return false;
+    }
+
+    uint64_t hash = 0;
+    for (size_t i = 0; i < pat->len; i++) {
+        hash = hash * ROLL_BASE + (unsigned char)data[i];
+    }
+    for (size_t i = 0;; i++) {
+        if (hash == pat->hash && !memcmp(data + i, pat->str, pat->len)) {
+            return true;
+        }
+        if (i + pat->len >= len) {
+            return false;
+        }
+        hash = (hash - (unsigned char)data[i] * pat->top) * ROLL_BASE +
+               (unsigned char)data[i + pat->len];
+    }
+}
+
+// Our own tools that are commonly watched are run in-process, with the same
+// code as the standalone ones and their output captured in memory.
+enum probe {PROBE_NONE, PROBE_SHOWMEM, PROBE_PS, PROBE_PS_ALL, PROBE_IPCS, PROBE_MOUNT};
+
+static enum probe find_probe(char **args, size_t argc) {
+    const char *name = strrchr(args[0], '/');
+    name = name == NULL ? args[0] : name + 1;
+    if (!strcmp(name, "showmem") && argc == 1) {
+        return PROBE_SHOWMEM;
+    } else if (!strcmp(name, "ps") && argc == 1) {
+        return PROBE_PS;
+    } else if (!strcmp(name, "ps") && argc == 2 && !strcmp(args[1], "-A")) {
+        return PROBE_PS_ALL;
+    } else if (!strcmp(name, "ipcs") && (argc == 1 || (argc == 2 && !strcmp(args[1], "-a")))) {
+        return PROBE_IPCS;
+    } else if (!strcmp(name, "mount") && argc == 1) {
+        return PROBE_MOUNT;
+    }
+    return PROBE_NONE;
+}
+
+// Returns the exit code the tool would have had.
+static int run_probe(enum probe probe, struct sysinfo_list *snapshot, FILE *out) {
+    struct mem_info meminfo;
+    switch (probe) {
+        case PROBE_SHOWMEM:
+            if (sysinfo_meminfo(&meminfo)) {
+                return 1;
+            }
+            sysinfo_print_meminfo(out, &meminfo);
+            return 0;
+        case PROBE_PS:
+        case PROBE_PS_ALL:
+            if (sysinfo_fetch(snapshot, SYSCALL_LISTPROCS, sizeof(struct procinfo))) {
+                return 1;
+            }
+            sysinfo_print_process_header(out);
+            for (size_t i = 0; i < snapshot->count; i++) {
+                const struct procinfo *proc = (const struct procinfo *)snapshot->items + i;
+                if (probe == PROBE_PS_ALL || proc->uid == getuid()) {
+                    sysinfo_print_process(out, proc);
+                }
+            }
+            return 0;
+        case PROBE_IPCS:
+            sysinfo_print_shm(out);
+            fputs("\n", out);
+            if (sysinfo_fetch(snapshot, SYSCALL_LISTFLOCKS, sizeof(struct flockinfo))) {
+                return 1;
+            }
+            sysinfo_print_flocks(out, snapshot);
+            return 0;
+        case PROBE_MOUNT:
+            if (sysinfo_fetch(snapshot, SYSCALL_LISTMOUNTS, sizeof(struct mountinfo))) {
+                return 1;
+            }
+            sysinfo_print_mounts(out, snapshot);
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// Run a probe with its output going to the capture buffer, which is grown
+// and the probe run again if it did not fit. Returns a wait status.
+static int capture_probe(enum probe probe, struct sysinfo_list *snapshot,
+                         struct capture *out) {
+    for (;;) {
+        if (out->cap == 0 || out->len >= out->cap - 1) {
+            size_t new_cap = out->cap ? out->cap * 2 : 4096;
+            char *grown = realloc(out->data, new_cap);
+            if (grown == NULL) {
+                return -1;
+            }
+            out->data = grown;
+            out->cap  = new_cap;
+        }
+
+        FILE *mem = fmemopen(out->data, out->cap, "w");
+        if (mem == NULL) {
+            return -1;
+        }
+        int code = run_probe(probe, snapshot, mem);
+        fflush(mem);
+        long written = ftell(mem);
+        fclose(mem);
+
+        out->len = written < 0 ? 0 : (size_t)written;
+        if (out->len < out->cap - 1) {
+            return (code & 0xff) << 8;
+        }
+    }
+}
+
+static int resize_screen(struct screen *scr, int rows, int cols) {
+    size_t count = (size_t)rows * cols;
+    char *cells = realloc(scr->cells, count);
+    bool *marked = realloc(scr->marked, count * sizeof(bool));
+    if (cells == NULL || marked == NULL) {
+        free(cells);
+        free(marked);
+        scr->cells = NULL;
+        scr->marked = NULL;
+        return -1;
+    }
+    memset(cells, ' ', count);
+    memset(marked, 0, count * sizeof(bool));
+    scr->cells = cells;
+    scr->marked = marked;
+    scr->rows = rows;
+    scr->cols = cols;
+    return 0;
+}
+
+// Lay the output out on the grid, lines past the width are cut.
+static void render(const struct capture *out, struct screen *scr) {
+    memset(scr->cells, ' ', (size_t)scr->rows * scr->cols);
+    int row = 0, col = 0;
+    for (size_t i = 0; i < out->len && row < scr->rows; i++) {
+        unsigned char ch = out->data[i];
+        if (ch == '\n') {
+            row++;
+            col = 0;
+        } else if (ch == '\t') {
+            col = (col / TAB_WIDTH + 1) * TAB_WIDTH;
+        } else if (ch >= ' ' && col < scr->cols) {
+            scr->cells[row * scr->cols + col++] = ch;
+        }
+    }
+}
+
+// Send the cells that changed from prev to next, which are the same size,
+// and mark them if highlighting. Screen rows start at first_row.
+static void redraw(const struct screen *prev, struct screen *next, bool highlight,
+                   int first_row) {
+    for (int row = 0; row < next->rows; row++) {
+        const char *old_cells = prev->cells + row * prev->cols;
+        const bool *old_marks = prev->marked + row * prev->cols;
+        char *cells = next->cells + row * next->cols;
+        bool *marks = next->marked + row * next->cols;
+
+        int first = -1, last = -1;
+        for (int col = 0; col < next->cols; col++) {
+            marks[col] = highlight && cells[col] != old_cells[col];
+            if (cells[col] != old_cells[col] || marks[col] != old_marks[col]) {
+                if (first == -1) {
+                    first = col;
+                }
+                last = col;
+            }
+        }
+        if (first == -1) {
+            continue;
+        }
+
+        printf("\e[%d;%dH", first_row + row, first + 1);
+        bool in_mark = false;
+        for (int col = first; col <= last; col++) {
+            if (marks[col] != in_mark) {
+                fputs(marks[col] ? "\e[7m" : "\e[0m", stdout);
+                in_mark = marks[col];
+            }
+            putchar(cells[col]);
+        }
+        if (in_mark) {
+            fputs("\e[0m", stdout);
+        }
+    }
+}
+
+static int64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static struct timespec ns_to_timespec(int64_t ns) {
+    struct timespec ts = {
+        .tv_sec  = ns / 1000000000LL,
+        .tv_nsec = ns % 1000000000LL
+    };
+    return ts;
+}
+
+static void draw_header(int cols, const char *title) {
+    time_t rawtime = time(NULL);
+    char timestr[32];
+    strftime(timestr, sizeof(timestr), "%a %b %e %H:%M:%S %Y", localtime(&rawtime));
+
+    int timelen = strlen(timestr);
+    int pad = cols - timelen;
+    if (pad < 0) {
+        pad = 0;
+        timelen = cols;
+    }
+    printf("\e[1;1H\e[7m%-*.*s%.*s\e[0m", pad, pad, title, timelen, timestr);
+}
 
 int main(int argc, char *argv[], char *envp[]) {
     int stop_on_fail          = 0;
+    bool stop_on_change       = false;
+    bool has_until            = false;
+    struct rolling_pattern until;
     int do_exec               = 0;
+    bool highlight            = false;
+    bool precise              = false;
     double seconds_for_update = 2.0;
 
+    static const struct option long_options[] = {
+        {"precise", no_argument,       NULL, 'p'},
+        {"errexit", no_argument,       NULL, 'e'},
+        {"chgexit", no_argument,       NULL, 'g'},
+        {"until",   required_argument, NULL, 'u'},
+        {NULL,      0,                 NULL, 0}
+    };
+
     char c;
-    while ((c = getopt (argc, argv, "hvexn:")) != -1) {
+    while ((c = getopt_long(argc, argv, "+hvexdgpn:", long_options, NULL)) != -1) {
         switch (c) {
             case 'h':
                 puts("Usage: watch [options] ...");
                 puts("");
                 puts("Options:");
-                puts("-h        Print this help message");
-                puts("-v        Print version information");
-                puts("-e        Stop updates on the first error");
-                puts("-x        Execute directly instead of passing to sh");
-                puts("-n <secs> Time to wait between updates, 2.0 by default");
+                puts("-h              Print this help message");
+                puts("-v              Print version information");
+                puts("-e|--errexit    Stop updates on the first error");
+                puts("-g|--chgexit    Stop updates when the output changes");
+                puts("--until <str>   Stop updates when the output contains str");
+                puts("-x              Execute directly instead of passing to sh");
+                puts("-d              Highlight the differences between updates");
+                puts("-p|--precise    Run updates at fixed times instead of waiting the");
+                puts("                interval after each, skipping the ones that were missed");
+                puts("-n <secs>       Time to wait between updates, 2.0 by default");
                 return 0;
             case 'v':
                 puts("watch" VERSION_STR);
@@ -57,12 +571,25 @@ int main(int argc, char *argv[], char *envp[]) {
             case 'e':
                 stop_on_fail = 1;
                 break;
+            case 'g':
+                stop_on_change = true;
+                break;
+            case 'u':
+                has_until = true;
+                build_pattern(&until, optarg);
+                break;
             case 'x':
                 do_exec = 1;
                 break;
+            case 'd':
+                highlight = true;
+                break;
+            case 'p':
+                precise = true;
+                break;
             case 'n':
                 seconds_for_update = atof(optarg);
-                if (seconds_for_update == 0) {
+                if (seconds_for_update <= 0) {
                     fputs("watch: invalid interval specified\n", stderr);
                     return 1;
                 }
@@ -80,69 +607,192 @@ int main(int argc, char *argv[], char *envp[]) {
     }
 
 END_WHILE:
-    struct tm *timeinfo;
-    time_t rawtime;
-    char *timestr;
-    struct winsize w;
-    size_t headerlen, timelen;
-
     size_t cmd_len = strlen(argv[optind]);
     for (int i = optind + 1; i < argc; i++) {
         cmd_len += 1 + strlen(argv[i]);
     }
-    char *cmd_str = calloc(cmd_len, sizeof(char));
+    char *cmd_str = calloc(cmd_len + 1, sizeof(char));
+    if (cmd_str == NULL) {
+        perror("watch: Could not allocate");
+        return 1;
+    }
     strcat(cmd_str, argv[optind]);
     for (int i = optind + 1; i < argc; i++) {
         strcat(cmd_str, " ");
         strcat(cmd_str, argv[i]);
     }
 
-    for (;;) {
-        time(&rawtime);
-        time (&rawtime);
-        timeinfo = localtime (&rawtime);
-        timestr = asctime(timeinfo);
+    size_t passed_argc, passed_envc;
+    for (passed_argc = 0; argv[optind + passed_argc]; passed_argc++);
+    for (passed_envc = 0; envp[passed_envc]; passed_envc++);
 
-        ioctl(0, TIOCGWINSZ, &w);
-        printf("\e[1;1H\e[2J\e[7m");
-        headerlen = printf("Every %.1f: \"%s\"", seconds_for_update, cmd_str);
-        timelen = strlen(timestr);
-        for (size_t i = 0; i <= w.ws_col - headerlen - timelen; i++) {
-            printf(" ");
+    // Everything needed to run the command is worked out once here, so that
+    // updates only spawn. Commands without shell syntax are split on blanks
+    // and run directly, the rest go to a shell that is kept running.
+    char **run_args = argv + optind;
+    size_t run_argc = passed_argc;
+    char *run_path = NULL;
+    char *words = NULL;
+    bool use_shell = !do_exec && needs_shell(cmd_str);
+    if (!do_exec && !use_shell) {
+        words = strdup(cmd_str);
+        run_args = calloc(cmd_len / 2 + 2, sizeof(char *));
+        if (words == NULL || run_args == NULL) {
+            perror("watch: Could not allocate");
+            return 1;
+        }
+        run_argc = 0;
+        for (char *tok = strtok(words, " \t"); tok != NULL; tok = strtok(NULL, " \t")) {
+            run_args[run_argc++] = tok;
+        }
+    }
+    enum probe probe = use_shell ? PROBE_NONE : find_probe(run_args, run_argc);
+    struct sysinfo_list snapshot = {0};
+    if (!use_shell && probe == PROBE_NONE) {
+        run_path = execpath_find(run_args[0]);
+        if (run_path == NULL && do_exec) {
+            fprintf(stderr, "watch: %s: command not found\n", run_args[0]);
+            return 1;
         }
-        printf("%s\e[0m\n", timestr);
+        use_shell = run_path == NULL;
+    }
 
-        int wstatus;
-        if (do_exec) {
-            int ret, errno;
+    struct shell sh = {.pid = -1};
+    char *script = NULL;
+    if (use_shell) {
+        script = malloc(cmd_len + 64);
+        if (script == NULL) {
+            perror("watch: Could not allocate");
+            return 1;
+        }
+        sprintf(script, "( %s\n) </dev/null 2>&1; printf '" SHELL_MARKER "%%d\\n' $?\n",
+                cmd_str);
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    // Batch every update into a single write.
+    static char out_buffer[65536];
+    setvbuf(stdout, out_buffer, _IOFBF, sizeof(out_buffer));
+
+    struct capture output = {0};
+    struct screen screens[2] = {0};
+    int current = 0;
+
+    // In precise mode updates happen at start + k * interval, with the ticks
+    // that passed while the command ran counted as overruns and skipped.
+    int64_t interval_ns = seconds_for_update * 1000000000.0;
+    int64_t deadline = monotonic_ns();
+    uint64_t runs = 0, overruns = 0;
+    int64_t run_total = 0, run_max = 0;
+    uint64_t last_hash = 0;
+    for (;;) {
+        struct winsize w;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) || w.ws_row < 2 || w.ws_col == 0) {
+            w.ws_row = DEFAULT_ROWS;
+            w.ws_col = DEFAULT_COLS;
+        }
 
-            size_t passed_argc, passed_envc;
-            for (passed_argc = 0; argv[optind + passed_argc]; passed_argc++);
-            for (passed_envc = 0; envp[passed_envc]; passed_envc++);
+        // A new size leaves nothing to compare with, so start from a blank
+        // screen for both frames.
+        struct screen *prev = &screens[current];
+        struct screen *next = &screens[!current];
+        bool fresh = false;
+        if (next->rows != w.ws_row - 1 || next->cols != w.ws_col) {
+            if (resize_screen(prev, w.ws_row - 1, w.ws_col) ||
+                resize_screen(next, w.ws_row - 1, w.ws_col)) {
+                fputs("watch: could not allocate the screen\n", stderr);
+                return 1;
+            }
+            printf("\e[1;1H\e[2J");
+            fresh = true;
+        }
 
-            size_t len = strlen(argv[optind]);
-            SYSCALL7(SYSCALL_SPAWN, argv[optind], len, argv + optind, passed_argc,
-               (uint64_t)envp, passed_envc, NULL);
-            if (errno) {
-               perror("watch: could not execute");
-               return 1;
+        int64_t run_start = monotonic_ns();
+        int wstatus;
+        if (use_shell) {
+            // The last command may have made the shell exit.
+            if (sh.pid == -1 && shell_start(&sh, envp, passed_envc)) {
+                perror("watch: could not start sh");
+                return 1;
             }
+            wstatus = shell_run(&sh, script, &output);
+        } else if (probe != PROBE_NONE) {
+            wstatus = capture_probe(probe, &snapshot, &output);
+        } else {
+            wstatus = run_captured(run_path, run_args, run_argc, envp, passed_envc, &output);
+        }
+        if (wstatus == -1) {
+            perror("watch: could not execute");
+            return 1;
+        }
+
+        int64_t run_time = monotonic_ns() - run_start;
+        runs++;
+        run_total += run_time;
+        if (run_time > run_max) {
+            run_max = run_time;
+        }
 
-            waitpid(ret, &wstatus, 0);
+        char title[512];
+        if (precise) {
+            snprintf(title, sizeof(title),
+                     "Every %.1fs (precise, %lu overruns, run %.1f/%.1f/%.1f ms): %s",
+                     seconds_for_update, overruns, run_time / 1e6,
+                     run_total / 1e6 / runs, run_max / 1e6, cmd_str);
         } else {
-            wstatus = system(cmd_str);
+            snprintf(title, sizeof(title), "Every %.1fs: %s", seconds_for_update, cmd_str);
         }
+        draw_header(w.ws_col, title);
+        render(&output, next);
+        redraw(prev, next, highlight && !fresh, 2);
+        fflush(stdout);
+        current = !current;
 
         if (WEXITSTATUS(wstatus) != 0 && stop_on_fail) {
             goto CLEANUP;
         }
+        if (stop_on_change) {
+            uint64_t hash = hash_output(output.data, output.len);
+            if (runs > 1 && hash != last_hash) {
+                goto CLEANUP;
+            }
+            last_hash = hash;
+        }
+        if (has_until && output_contains(&until, output.data, output.len)) {
+            goto CLEANUP;
+        }
 
-        struct timespec duration;
-        duration.tv_sec  = (time_t)seconds_for_update;
-        duration.tv_nsec = (long)(seconds_for_update / 1000000);
-        nanosleep(&duration, NULL);
+        if (precise) {
+            deadline += interval_ns;
+            int64_t now = monotonic_ns();
+            if (now >= deadline) {
+                uint64_t missed = (now - deadline) / interval_ns + 1;
+                overruns += missed;
+                deadline += missed * interval_ns;
+            }
+            struct timespec wake = ns_to_timespec(deadline);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR);
+        } else {
+            struct timespec duration = ns_to_timespec(interval_ns);
+            nanosleep(&duration, NULL);
+        }
     }
 
 CLEANUP:
+    if (sh.pid != -1) {
+        shell_stop(&sh);
+    }
+    if (words != NULL) {
+        free(run_args);
+        free(words);
+    }
+    free(run_path);
+    sysinfo_list_free(&snapshot);
+    free(script);
     free(cmd_str);
+    free(output.data);
+    for (int i = 0; i < 2; i++) {
+        free(screens[i].cells);
+        free(screens[i].marked);
+    }
 }